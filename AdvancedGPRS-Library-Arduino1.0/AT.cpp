@@ -46,6 +46,8 @@
   
 #include "AT.h"
 
+#include <avr/eeprom.h>
+
 extern "C" {
   #include <string.h>
 }
@@ -136,6 +138,16 @@ int AT::LibVer(void)
 
 AT::AT(void)
 {
+  byte i;
+
+  lastSMSRef = -1;
+  smsMemStorage = SMS_STORAGE_UNKNOWN;
+  for (i = 0; i < SMS_MEM_LAST_ITEM; i++) {
+    smsMemUsed[i] = 0;
+    smsMemTotal[i] = 0;
+  }
+  sms_mem_policy = SMS_MEM_POLICY_NONE;
+  pb_cache_valid = 0;
 }
 
 /**********************************************************
@@ -147,8 +159,15 @@ void AT::InitSerLine(long baud_rate)
   outSerial.begin(baud_rate);
   // communication line is not used yet = free
   SetCommLineStatus(CLS_FREE);
+  comm_line_used = 0;
+  cds_count = 0;
   // pointer is initialized to the first item of comm. buffer
   p_comm_buf = &comm_buf[0];
+  // SMS message format is not known until AT+CMGF is sent
+  sms_mode = SMS_MODE_UNKNOWN;
+  // module defaults: "IRA" character set, no status report, 7-bit data coding
+  sms_ucs2 = 0;
+  csmp_fo = 17;
 }
 
 /**********************************************************
@@ -275,6 +294,9 @@ byte AT::IsRxFinished(void)
       ret_val = RX_FINISHED;
     }
   }
+  // status report can come together with the response of any command
+  // (not in the data state - the payload is not text)
+  if (ret_val == RX_FINISHED && flag_read_when_buffer_full) ScanCDS((char *)comm_buf);
   return (ret_val);
 }
 
@@ -301,6 +323,21 @@ byte AT::IsStringReceived(char const *compare_string)
   return (ret_val);
 }
 
+/**********************************************************
+Method checks if the line is the final error response
+"ERROR" or "+CME ERROR: <err>" or "+CMS ERROR: <err>"
+(error codes are enabled by AT+CMEE=1 - see InitParam())
+
+return: 0 - line is not an error
+        1 - line is an error
+**********************************************************/
+byte AT::IsErrorLine(char const *line)
+{
+  return (strcmp(line, "ERROR") == 0
+          || strncmp(line, "+CME ERROR:", 11) == 0
+          || strncmp(line, "+CMS ERROR:", 11) == 0);
+}
+
 /**********************************************************
 Method waits for response
 
@@ -372,6 +409,49 @@ byte AT::WaitResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout,
 }
 
 
+/**********************************************************
+Method waits for response with specific response string
+- the same as WaitResp() above but reception is finished
+  immediately after final result code "OK" or "ERROR" is received
+  so it is not necessary to wait for the inter-character tmout
+
+      start_comm_tmout    - maximum waiting time for receiving the first response
+                            character (in msec.)
+      max_interchar_tmout - maximum tmout between incoming characters 
+                            in msec.  
+      expected_resp_string - expected string
+return: 
+      RX_FINISHED_STR_RECV,     finished and expected string received
+      RX_FINISHED_STR_NOT_RECV  finished, but expected string not received
+      RX_TMOUT_ERR              finished, no character received 
+                                initial communication tmout occurred
+**********************************************************/
+byte AT::WaitFinalResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout, 
+                        char const *expected_resp_string)
+{
+  byte status;
+  uint16_t last_len = 0;
+
+  RxInit(start_comm_tmout, max_interchar_tmout, 1, 1);
+  do {
+    status = IsRxFinished();
+    if (comm_buf_len != last_len) {
+      // something new was received => check final result code
+      last_len = comm_buf_len;
+      if (IsStringReceived("OK\r\n") || IsStringReceived("ERROR")) {
+        status = RX_FINISHED;
+      }
+    }
+  } while (status == RX_NOT_FINISHED);
+
+  if (status == RX_FINISHED) {
+    if (IsStringReceived(expected_resp_string)) return (RX_FINISHED_STR_RECV);
+    return (RX_FINISHED_STR_NOT_RECV);
+  }
+  return (RX_TMOUT_ERR);
+}
+
+
 /**********************************************************
 Method sends AT command and waits for response
 
@@ -417,6 +497,226 @@ char AT::SendATCmdWaitResp(char const *AT_cmd_string,
   return (ret_val);
 }
 
+/**********************************************************
+Method selects SMS message format(AT+CMGF) - text or PDU
+and for the text mode also the character set(AT+CSCS)
+Commands are sent only in case the required format differs
+from the currently selected one so it is cheap to call
+this method before every SMS command
+
+!!This function is used internally by SMS methods when the
+comm. line is already reserved(CLS_ATCMD) so it doesn't
+check the comm. line status
+
+mode:   SMS_MODE_TEXT      - text mode, "IRA" character set
+        SMS_MODE_TEXT_UCS2 - text mode, "UCS2" character set
+                             and UCS2 data coding for sent SMS
+        SMS_MODE_PDU       - PDU mode
+no_of_attempts: max. number of attempts for every command
+                (version without this parameter uses 3)
+
+return: 
+        AT_RESP_ERR_NO_RESP = -1,   // no response received
+        AT_RESP_ERR_DIF_RESP = 0,   // format was not changed
+        AT_RESP_OK = 1,             // format is selected
+**********************************************************/
+char AT::SelectSMSMode(byte mode)
+{
+  return (SelectSMSMode(mode, 3));
+}
+
+char AT::SelectSMSMode(byte mode, byte no_of_attempts)
+{
+  char ret_val = AT_RESP_OK;
+  byte cmgf_mode;
+  byte ucs2;
+
+  cmgf_mode = (mode == SMS_MODE_PDU) ? SMS_MODE_PDU : SMS_MODE_TEXT;
+  if (sms_mode != cmgf_mode) {
+    if (cmgf_mode == SMS_MODE_PDU) {
+      ret_val = SendATCmdWaitResp("AT+CMGF=0", START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", no_of_attempts);
+    }
+    else {
+      ret_val = SendATCmdWaitResp("AT+CMGF=1", START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", no_of_attempts);
+    }
+    if (ret_val == AT_RESP_OK) sms_mode = cmgf_mode;
+    else sms_mode = SMS_MODE_UNKNOWN;
+  }
+
+  // character set is used only in the text mode
+  ucs2 = (mode == SMS_MODE_TEXT_UCS2);
+  if (ret_val == AT_RESP_OK && cmgf_mode == SMS_MODE_TEXT && sms_ucs2 != ucs2) {
+    if (ucs2) {
+      ret_val = SendATCmdWaitResp("AT+CSCS=\"UCS2\"", START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", no_of_attempts);
+    }
+    else {
+      ret_val = SendATCmdWaitResp("AT+CSCS=\"IRA\"", START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", no_of_attempts);
+    }
+    // data coding scheme for sent SMS follows the character set
+    sms_ucs2 = ucs2;
+    if (ret_val == AT_RESP_OK) ret_val = SendCSMP();
+    if (ret_val != AT_RESP_OK) sms_ucs2 = 0xFF; // not known
+  }
+  return (ret_val);
+}
+
+/**********************************************************
+Method sends text mode parameters of the sent SMS
+AT+CSMP=<fo>,167,0,<dcs>
+<fo> is given by the status report request, <dcs> by the
+selected character set(0 - default alphabet, 8 - UCS2)
+
+!!This function is used internally when the comm. line
+is already reserved(CLS_ATCMD)
+
+return: 
+        AT_RESP_ERR_NO_RESP = -1,   // no response received
+        AT_RESP_ERR_DIF_RESP = 0,   // parameters were not set
+        AT_RESP_OK = 1,             // parameters are set
+**********************************************************/
+char AT::SendCSMP(void)
+{
+  outSerial.print(F("AT+CSMP="));
+  outSerial.print((int)csmp_fo);
+  outSerial.print(F(",167,0,"));
+  outSerial.print(sms_ucs2 == 1 ? 8 : 0);
+  outSerial.print(F("\r"));
+  switch (WaitResp(START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK")) {
+    case RX_TMOUT_ERR:
+      return (AT_RESP_ERR_NO_RESP);
+    case RX_FINISHED_STR_RECV:
+      return (AT_RESP_OK);
+  }
+  return (AT_RESP_ERR_DIF_RESP);
+}
+
+/**********************************************************
+Method enables or disables status report request for SMS
+sent in the text mode(first octet 49 or 17 in AT+CSMP)
+
+!!This function is used internally when the comm. line
+is already reserved(CLS_ATCMD)
+
+enable: 1 - status report is requested
+        0 - status report is not requested
+
+return: 
+        AT_RESP_ERR_NO_RESP = -1,   // no response received
+        AT_RESP_ERR_DIF_RESP = 0,   // parameters were not set
+        AT_RESP_OK = 1,             // parameters are set
+**********************************************************/
+char AT::SetStatusReport(byte enable)
+{
+  // 17 = SMS-SUBMIT, relative validity period
+  // 49 = the same + status report request
+  csmp_fo = enable ? 49 : 17;
+  return (SendCSMP());
+}
+
+static const char hex_digits[] PROGMEM = "0123456789ABCDEF";
+
+/**********************************************************
+Methods for the hexadecimal strings - all hex data(PDU,
+UCS2 text, status reports) are converted by them
+
+HexNibble() returns value of the hex digit or -1 if the
+character is not a hex digit(upper and lower case)
+
+HexToByte() converts 2 hex digits to the byte
+return: 0 - there are not 2 hex digits
+        1 - byte was converted
+
+WriteHexByte() sends the byte as 2 hex digits(upper case)
+to the GSM module
+**********************************************************/
+char AT::HexNibble(char ch)
+{
+  if (ch >= '0' && ch <= '9') return (ch - '0');
+  ch |= 0x20;   // lower case
+  if (ch >= 'a' && ch <= 'f') return (ch - 'a' + 10);
+  return (-1);
+}
+
+byte AT::HexToByte(char *p_char, byte *value)
+{
+  char high;
+  char low;
+
+  high = HexNibble(p_char[0]);
+  if (high < 0) return (0);
+  low = HexNibble(p_char[1]);
+  if (low < 0) return (0);
+  *value = (high << 4) | low;
+  return (1);
+}
+
+void AT::WriteHexByte(byte value)
+{
+  outSerial.write(pgm_read_byte(&hex_digits[value >> 4]));
+  outSerial.write(pgm_read_byte(&hex_digits[value & 0x0F]));
+}
+
+/**********************************************************
+Method finds status reports in the received text and stores
+<mr> and <st> of them for CheckDeliveryReports()
+The text is not modified, so it can be used by the caller.
+- text mode: +CDS: <fo>,<mr>,[<ra>],[<tora>],<scts>,<dt>,<st>
+- PDU mode:  +CDS: <length><CR><LF><pdu>
+Reports which don't fit to the CDS_PENDING_SLOTS are discarded.
+**********************************************************/
+void AT::ScanCDS(char *p_char)
+{
+  char *p_line_end;
+  char *p_first;
+  char *p_last;
+  int hex_len;
+  int pdu_pos;
+  byte mr;
+  byte value;
+
+  while ((p_char = strstr(p_char, "+CDS:")) != NULL) {
+    p_char += 5;
+    p_line_end = strchr(p_char, '\r');
+    if (p_line_end == NULL) p_line_end = p_char + strlen(p_char);
+
+    // <mr> is behind the first comma, <st> behind the last one
+    // (time stamps contain comma but they are quoted before <st>)
+    p_first = NULL;
+    for (p_last = p_char; p_last < p_line_end; p_last++) {
+      if (*p_last == ',' && p_first == NULL) p_first = p_last;
+    }
+    while (p_first != NULL && *p_last != ',') p_last--;
+    if (p_first != NULL) {
+      mr = atoi(p_first + 1);
+      value = atoi(p_last + 1);
+    }
+    else if (p_line_end[0] == '\r' && p_line_end[1] == '\n') {
+      // PDU mode - only <length> is in the line, hex PDU follows
+      // SCA, <fo>, <mr>, RA(digits, TOA, BCD), SCTS(7), DT(7), <st>
+      p_char = p_line_end + 2;
+      for (hex_len = 0; HexNibble(p_char[hex_len]) >= 0; hex_len++);
+      if (hex_len < 2) continue;
+      HexToByte(p_char, &value);
+      pdu_pos = 1 + value;
+      if (2 * (pdu_pos + 3) > hex_len) continue;
+      HexToByte(p_char + 2 * pdu_pos, &value);
+      if ((value & 0x03) != 0x02) continue;   // not SMS-STATUS-REPORT
+      HexToByte(p_char + 2 * (pdu_pos + 1), &mr);
+      HexToByte(p_char + 2 * (pdu_pos + 2), &value);
+      pdu_pos += 4 + ((value + 1) >> 1) + 14;
+      if (2 * (pdu_pos + 1) > hex_len) continue;
+      HexToByte(p_char + 2 * pdu_pos, &value);
+    }
+    else continue;
+
+    if (cds_count < CDS_PENDING_SLOTS) {
+      cds_mr[cds_count] = mr;
+      cds_st[cds_count] = value;
+      cds_count++;
+    }
+  }
+}
+
 /**********************************************************
 Method sends SMS
 
@@ -435,6 +735,7 @@ return:
         -----------
         0 - SMS was not sent
         1 - SMS was sent
+            message reference of the SMS is placed to the lastSMSRef
 
 
 an example of usage:
@@ -445,10 +746,15 @@ char AT::SendSMS(char *number_str, char *message_str)
 {
   char ret_val = -1;
   byte i;
+#ifndef DEBUG_SMS_ENABLED
+  char *p_char;
+#endif
 
   if (CLS_FREE != GetCommLineStatus()) return (ret_val);
   SetCommLineStatus(CLS_ATCMD);
   ret_val = 0; // still not send
+  lastSMSRef = -1;
+  SelectSMSMode(SMS_MODE_TEXT);
   // try to send SMS 3 times in case there is some problem
   for (i = 0; i < 3; i++) {
     // send  AT+CMGS="number_str"
@@ -469,6 +775,9 @@ char AT::SendSMS(char *number_str, char *message_str)
 #else 
       outSerial.write(26);
       if (RX_FINISHED_STR_RECV == WaitResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CMGS")) {
+        // response: +CMGS: <mr>
+        p_char = strchr((char *)comm_buf, ':');
+        if (p_char != NULL) lastSMSRef = atoi(p_char + 1);
 #endif
         // SMS was send correctly 
         ret_val = 1;
@@ -543,6 +852,7 @@ return:
         -----------
         0 - SMS memory was not initialized
         1 - SMS memory was initialized
+            smsMemUsed[] and smsMemTotal[] are updated
 
 **********************************************************/
 char AT::InitSMSMemory(void) 
@@ -557,12 +867,8 @@ char AT::InitSMSMemory(void)
   SendATCmdWaitResp("AT+CNMI=2,0", START_LONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", 2);
 
   // send AT command to init memory for SMS in the SIM card
-  // response:
-  // +CPMS: <usedr>,<totalr>,<usedw>,<totalw>,<useds>,<totals>
-  if (AT_RESP_OK == SendATCmdWaitResp("AT+CPMS=\"SM\",\"SM\",\"SM\"", START_LONG_COMM_TMOUT, START_LONG_COMM_TMOUT, "+CPMS:", 10)) {
-    ret_val = 1;
-  }
-  else ret_val = 0;
+  // counters of the storages are parsed from the response
+  ret_val = SendCPMS(SMS_STORAGE_SM);
 
   SetCommLineStatus(CLS_FREE);
   return (ret_val);
@@ -618,6 +924,7 @@ char AT::IsSMSPresent(byte required_status)
   if (CLS_FREE != GetCommLineStatus()) return (ret_val);
   SetCommLineStatus(CLS_ATCMD);
   ret_val = 0; // still not present
+  SelectSMSMode(SMS_MODE_TEXT);
 
   switch (required_status) {
     case SMS_UNREAD:
@@ -696,8 +1003,10 @@ Method reads SMS from specified memory(SIM) position
 position:     SMS position <1..20>
 phone_number: a pointer where the phone number string of received SMS will be placed
               so the space for the phone number string must be reserved - see example
+              (max. PB_NUMBER_LEN characters + 0x00)
 SMS_text  :   a pointer where SMS text will be placed
-max_SMS_len:  maximum length of SMS text excluding also string terminating 0x00 character
+max_SMS_len:  size of the SMS_text buffer, SMS text is cut to max_SMS_len-1
+              characters so there is always place for the terminating 0x00
               
 return: 
         ERROR ret. val:
@@ -733,17 +1042,86 @@ an example of usage:
         }        
 **********************************************************/
 char AT::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS_len) 
+{
+  return (RcvSMS(position, phone_number, NULL, SMS_text, max_SMS_len, SMS_MODE_TEXT));
+}
+
+/**********************************************************
+Method reads SMS from specified memory(SIM) position and
+passes the SMS text to the sink function in chunks as it
+is received, so the length of the SMS text is not limited
+by the comm_buf or by any other buffer.
+
+position:     SMS position <1..20>
+phone_number: a pointer where the phone number string of received SMS will be placed
+              (max. PB_NUMBER_LEN characters + 0x00)
+sink:         function called for every chunk of the SMS text,
+              chunk is finished by 0x00, max. COMM_BUF_LEN characters
+
+return: 
+        the same as GetSMS()
+
+
+an example of usage:
+        void SMSTextChunk(char *chunk, byte len)
+        {
+          ...
+        }
+
+        gsm.GetSMSStream(position, phone_num, SMSTextChunk);
+**********************************************************/
+char AT::GetSMSStream(byte position, char *phone_number, sms_sink_t sink) 
+{
+  return (RcvSMS(position, phone_number, sink, NULL, 0, SMS_MODE_TEXT));
+}
+
+/**********************************************************
+Method reads SMS and parses the response as it comes:
+
+<CR><LF>+CMGR: "REC UNREAD","+XXXXXXXXXXXX",,"02/03/18,09:54:28+40"<CR><LF>
+There is SMS text<CR><LF>
+<CR><LF>OK<CR><LF>
+
+The header line is stored in the comm_buf and parsed, then
+the SMS text is collected in the comm_buf in chunks which
+are copied to the SMS_text buffer or passed to the sink
+function. Final <CR><LF><CR><LF>OK<CR><LF> is held back
+until it is sure it is not a part of the text, so also
+multi-line SMS are read completely.
+
+sink:         function for the SMS text chunks or NULL
+SMS_text:     buffer for the SMS text or NULL
+max_SMS_len:  size of the SMS_text buffer
+mode:         SMS_MODE_TEXT or SMS_MODE_TEXT_UCS2 - phone number
+              and text are converted from UCS2 hex to UTF-8
+
+return: 
+        the same as GetSMS()
+**********************************************************/
+char AT::RcvSMS(byte position, char *phone_number, sms_sink_t sink,
+                char *SMS_text, byte max_SMS_len, byte mode)
 {
   char ret_val = -1;
+  char const *final_resp = "\r\n\r\nOK\r\n";
+  char hold[8];                   // possible beginning of the final response
+  byte hold_len = 0;
+  byte in_text = 0;
+  byte text_len = 0;
+  byte ch;
+  uint16_t len = 0;
+  uint16_t hex_len;
+  uint16_t tmout;
+  unsigned long prev_time;
   char *p_char; 
   char *p_char1;
-  byte len;
 
   if (position == 0) return (-3);
   if (CLS_FREE != GetCommLineStatus()) return (ret_val);
   SetCommLineStatus(CLS_ATCMD);
   phone_number[0] = 0;  // end of string for now
-  ret_val = GETSMS_NO_SMS; // still no SMS
+  if (SMS_text != NULL && max_SMS_len) SMS_text[0] = 0;
+  ret_val = -2; // no response yet
+  SelectSMSMode(mode);
   
   //send "AT+CMGR=X" - where X = position
   outSerial.print(F("AT+CMGR="));
@@ -752,104 +1130,112 @@ char AT::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS_
 
   // 5000 msec. for initial comm tmout
   // 100 msec. for inter character tmout
-  switch (WaitResp(START_XLONG_COMM_TMOUT, MAX_MID_INTERCHAR_TMOUT, "+CMGR")) {
-    case RX_TMOUT_ERR:
-      // response was not received in specific time
-      ret_val = -2;
-      break;
+  tmout = START_XLONG_COMM_TMOUT;
+  prev_time = millis();
+  while ((unsigned long)(millis() - prev_time) < tmout) {
+    if (!outSerial.available()) continue;
+    ch = outSerial.read();
+    prev_time = millis();
+    tmout = MAX_MID_INTERCHAR_TMOUT;
+
+    if (!in_text) {
+      // header - store line to the comm_buf
+      if (ch != '\n') {
+        if (ch != '\r' && len < COMM_BUF_LEN) comm_buf[len++] = ch;
+        continue;
+      }
+      comm_buf[len] = 0x00;
+      comm_buf_len = len;
+      len = 0;
 
-    case RX_FINISHED_STR_NOT_RECV:
-      // OK was received => there is NO SMS stored in this position
-      if(IsStringReceived("OK")) {
-        // there is only response <CR><LF>OK<CR><LF> 
-        // => there is NO SMS
-        ret_val = GETSMS_NO_SMS;
+      if (strncmp((char *)comm_buf, "+CMGR:", 6) == 0) {
+        if (strstr((char *)comm_buf, "\"REC UNREAD\"") != NULL) ret_val = GETSMS_UNREAD_SMS;
+        else if (strstr((char *)comm_buf, "\"REC READ\"") != NULL) ret_val = GETSMS_READ_SMS;
+        else ret_val = GETSMS_OTHER_SMS; // other type like stored for sending..
+
+        // extract phone number string
+        // ---------------------------
+        p_char = strchr((char *)(comm_buf),',');
+        if (p_char != NULL && p_char[1] == '"') {
+          p_char += 2; // we are on the first phone number character
+          p_char1 = strchr(p_char, '"');
+          if (p_char1 != NULL) *p_char1 = 0; // end of string
+          if (mode == SMS_MODE_TEXT_UCS2) {
+            hex_len = strlen(p_char);
+            p_char[UCS2ToUTF8(p_char, &hex_len)] = 0;
+          }
+          if (strlen(p_char) > PB_NUMBER_LEN) p_char[PB_NUMBER_LEN] = 0;
+          strcpy(phone_number, p_char);
+        }
+        // SMS text follows
+        in_text = 1;
       }
-      else if(IsStringReceived("ERROR")) {
-        // error should not be here but for sure
+      else if (strncmp((char *)comm_buf, "OK", 2) == 0
+               || strstr((char *)comm_buf, "ERROR") != NULL) {
+        // there is NO SMS stored in this position
         ret_val = GETSMS_NO_SMS;
+        break;
       }
-      break;
+      continue;
+    }
 
-    case RX_FINISHED_STR_RECV:
-      // find out what was received exactly
-
-      //response for new SMS:
-      //<CR><LF>+CMGR: "REC UNREAD","+XXXXXXXXXXXX",,"02/03/18,09:54:28+40"<CR><LF>
-		  //There is SMS text<CR><LF>OK<CR><LF>
-      if(IsStringReceived("\"REC UNREAD\"")) { 
-        // get phone number of received SMS: parse phone number string 
-        // +XXXXXXXXXXXX
-        // -------------------------------------------------------
-        ret_val = GETSMS_UNREAD_SMS;
-      }
-      //response for already read SMS = old SMS:
-      //<CR><LF>+CMGR: "REC READ","+XXXXXXXXXXXX",,"02/03/18,09:54:28+40"<CR><LF>
-		  //There is SMS text<CR><LF>
-      else if(IsStringReceived("\"REC READ\"")) {
-        // get phone number of received SMS
-        // --------------------------------
-        ret_val = GETSMS_READ_SMS;
-      }
-      else {
-        // other type like stored for sending.. 
-        ret_val = GETSMS_OTHER_SMS;
+    // SMS text
+    hold[hold_len++] = ch;
+    while (hold_len && strncmp(hold, final_resp, hold_len) != 0) {
+      // the first held character is a part of the SMS text
+      comm_buf[len++] = hold[0];
+      if (len == COMM_BUF_LEN) {
+        len = RcvSMSChunk(len, sink, SMS_text, max_SMS_len, &text_len, mode);
       }
+      hold_len--;
+      memmove(hold, hold + 1, hold_len);
+    }
+    if (hold_len == 8) break; // whole final response received
+  }
 
-      // extract phone number string
-      // ---------------------------
-      p_char = strchr((char *)(comm_buf),',');
-      p_char1 = p_char+2; // we are on the first phone number character
-      p_char = strchr((char *)(p_char1),'"');
-      if (p_char != NULL) {
-        *p_char = 0; // end of string
-        strcpy(phone_number, (char *)(p_char1));
-      }
+  // the rest of the text
+  if (in_text && len) RcvSMSChunk(len, sink, SMS_text, max_SMS_len, &text_len, mode);
+  comm_buf_len = 0;
 
+  // phonebook and +CLCC expect "IRA" character set
+  if (mode == SMS_MODE_TEXT_UCS2) SelectSMSMode(SMS_MODE_TEXT);
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
 
-      // get SMS text and copy this text to the SMS_text buffer
-      // ------------------------------------------------------
-      p_char = strchr(p_char+1, 0x0a);  // find <LF>
-      if (p_char != NULL) {
-        // next character after <LF> is the first SMS character
-        p_char++; // now we are on the first SMS character 
+/**********************************************************
+Method processes the chunk of the SMS text in the comm_buf
+UCS2 hex text is converted to UTF-8 in place, then the chunk
+is passed to the sink or appended to the SMS_text buffer.
 
-        // find <CR> as the end of SMS string
-        p_char1 = strchr((char *)(p_char), 0x0d);  
-        if (p_char1 != NULL) {
-          // finish the SMS text string 
-          // because string must be finished for right behaviour 
-          // of next strcpy() function
-          *p_char1 = 0; 
-        }
-        // in case there is not finish sequence <CR><LF> because the SMS is
-        // too long (more then 130 characters) sms text is finished by the 0x00
-        // directly in the WaitResp() routine
-
-        // find out length of the SMS (excluding 0x00 termination character)
-        len = strlen(p_char);
-
-        if (len < max_SMS_len) {
-          // buffer SMS_text has enough place for copying all SMS text
-          // so copy whole SMS text
-          // from the beginning of the text(=p_char position) 
-          // to the end of the string(= p_char1 position)
-          strcpy(SMS_text, (char *)(p_char));
-        }
-        else {
-          // buffer SMS_text doesn't have enough place for copying all SMS text
-          // so cut SMS text to the (max_SMS_len-1)
-          // (max_SMS_len-1) because we need 1 position for the 0x00 as finish 
-          // string character
-          memcpy(SMS_text, (char *)(p_char), (max_SMS_len-1));
-          SMS_text[max_SMS_len] = 0; // finish string
-        }
-      }
-      break;
+len:  number of characters in the comm_buf
+
+return: number of characters left at the beginning of the
+        comm_buf for the next chunk(incomplete UCS2 character)
+**********************************************************/
+uint16_t AT::RcvSMSChunk(uint16_t len, sms_sink_t sink,
+                         char *SMS_text, byte max_SMS_len, byte *text_len, byte mode)
+{
+  uint16_t hex_len = len;
+  uint16_t out_len = len;
+
+  if (mode == SMS_MODE_TEXT_UCS2) {
+    out_len = UCS2ToUTF8((char *)comm_buf, &hex_len);
+  }
+  comm_buf[out_len] = 0x00;
+
+  if (sink != NULL && out_len) sink((char *)comm_buf, out_len);
+  if (SMS_text != NULL && max_SMS_len) {
+    if (out_len > max_SMS_len - 1 - *text_len) out_len = max_SMS_len - 1 - *text_len;
+    memcpy(SMS_text + *text_len, comm_buf, out_len);
+    *text_len += out_len;
+    SMS_text[*text_len] = 0x00;
   }
 
-  SetCommLineStatus(CLS_FREE);
-  return (ret_val);
+  // move not converted characters to the beginning
+  len -= hex_len;
+  memmove(comm_buf, comm_buf + hex_len, len);
+  return (len);
 }
 
 /**********************************************************
@@ -863,7 +1249,7 @@ position:     SMS position to be read <1..20>
 phone_number: a pointer where the tel. number string of received SMS will be placed
               so the space for the phone number string must be reserved - see example
 SMS_text  :   a pointer where SMS text will be placed
-max_SMS_len:  maximum length of SMS text excluding terminating 0x00 character
+max_SMS_len:  size of the SMS_text buffer, see GetSMS()
 
 first_authorized_pos: initial SIM phonebook position where the authorization process
                       starts
@@ -923,7 +1309,6 @@ char AT::GetAuthorizedSMS(byte position, char *phone_number, char *SMS_text, byt
                            byte first_authorized_pos, byte last_authorized_pos)
 {
   char ret_val = -1;
-  byte i;
 
 #ifdef DEBUG_PRINT
     DebugPrint("DEBUG GetAuthorizedSMS\r\n", 0);
@@ -958,14 +1343,11 @@ char AT::GetAuthorizedSMS(byte position, char *phone_number, char *SMS_text, byt
     }
     else {
       ret_val = GETSMS_NOT_AUTH_SMS;  // authorization not valid yet
-      for (i = first_authorized_pos; i <= last_authorized_pos; i++) {
-        if (ComparePhoneNumber(i, phone_number)) {
-          // phone numbers are identical
-          // authorization is OK
-          // ---------------------------
-          ret_val = GETSMS_AUTH_SMS;
-          break;  // and finish authorization
-        }
+      if (1 == IsAuthorizedNumber(phone_number, first_authorized_pos, last_authorized_pos)) {
+        // phone number is in the authorized range
+        // authorization is OK
+        // ---------------------------------------
+        ret_val = GETSMS_AUTH_SMS;
       }
     }
   }
@@ -993,6 +1375,7 @@ return:
 char AT::DeleteSMS(byte position) 
 {
   char ret_val = -1;
+  byte i;
 
   if (position == 0) return (-3);
   if (CLS_FREE != GetCommLineStatus()) return (ret_val);
@@ -1016,6 +1399,10 @@ char AT::DeleteSMS(byte position)
     case RX_FINISHED_STR_RECV:
       // OK was received => SMS deleted
       ret_val = 1;
+      // all storages are the same - see InitSMSMemory()
+      for (i = 0; i < SMS_MEM_LAST_ITEM; i++) {
+        if (smsMemUsed[i]) smsMemUsed[i]--;
+      }
       break;
 
     case RX_FINISHED_STR_NOT_RECV:
@@ -1153,6 +1540,8 @@ char AT::WritePhoneNumber(byte position, char *phone_number)
   if (CLS_FREE != GetCommLineStatus()) return (ret_val);
   SetCommLineStatus(CLS_ATCMD);
   ret_val = 0; // phone number was not written yet
+  // phonebook is changed => cache is loaded again when necessary
+  InvalidatePhonebookCache();
   
   //send: AT+CPBW=XY,"00420123456789"
   // where XY = position,
@@ -1248,3 +1637,923 @@ char AT::ComparePhoneNumber(byte position, char *phone_number)
   }
   return (ret_val);
 }
+
+/**********************************************************
+Method converts phone number string to the key of the phonebook
+cache - the last WL_MATCH_DIGITS digits packed by WLNormalize(),
+so the numbers match the same way as in the whitelist
+("+420123456789" and "00420123456789" are the same number)
+
+key: buffer for (WL_MATCH_DIGITS + 1) / 2 bytes
+
+return: number of digits in the key, 0 for the number without digits
+**********************************************************/
+byte AT::PhonebookCacheKey(char *phone_number, byte *key)
+{
+  byte bcd[WL_NUMBER_DIGITS / 2];
+  byte digits;
+
+  // international prefix "00" is the same as "+"(short numbers)
+  if (phone_number[0] == '0' && phone_number[1] == '0') phone_number += 2;
+  digits = WLNormalize(phone_number, bcd);
+  if (digits > WL_MATCH_DIGITS) digits = WL_MATCH_DIGITS;
+  memcpy(key, bcd, PB_CACHE_KEY_LEN);
+  // digits behind the key are not compared
+  if (digits & 1) key[digits >> 1] &= 0x0F;
+  return (digits);
+}
+
+/**********************************************************
+Method puts phone number to the phonebook cache
+Numbers are counted also when the cache is full, so
+LoadPhonebookCache() can find out the cache is too small.
+**********************************************************/
+void AT::PhonebookCacheAdd(char *phone_number)
+{
+  byte digits;
+
+  if (pb_cache_count < PB_CACHE_SLOTS) {
+    digits = PhonebookCacheKey(phone_number, pb_cache_key[pb_cache_count]);
+    if (digits == 0) return;
+    pb_cache_digits[pb_cache_count] = digits;
+  }
+  if (pb_cache_count < 0xFF) pb_cache_count++;
+}
+
+/**********************************************************
+Method loads phone numbers from the authorized range
+of the SIM phonebook to the cache
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - there are more than PB_CACHE_SLOTS numbers in the range
+        -4 - GSM module has answered error(SIM busy etc.),
+             cache is not loaded
+
+        OK ret val:
+        -----------
+        1 - cache is loaded
+**********************************************************/
+char AT::LoadPhonebookCache(byte first_authorized_pos, byte last_authorized_pos)
+{
+  int ret_val;
+
+  pb_cache_valid = 0;
+  pb_cache_count = 0;
+
+  // whole range is read by one command
+  ret_val = ReadPhonebookRange(first_authorized_pos, last_authorized_pos, NULL, NULL, 1);
+  if (ret_val < 0) return (ret_val);
+  if (pb_cache_count > PB_CACHE_SLOTS) return (-3);
+
+  pb_cache_first = first_authorized_pos;
+  pb_cache_last = last_authorized_pos;
+  pb_cache_valid = 1;
+  return (1);
+}
+
+/**********************************************************
+Method checks if the phone number is stored in the authorized
+range of the SIM phonebook
+
+The authorized range is read from the SIM only once and kept
+in the RAM as packed digits of the numbers, so next checks
+don't need any communication with the GSM module. The cache
+is loaded again after WritePhoneNumber() or if the range
+is changed. Numbers match if their last WL_MATCH_DIGITS digits
+are the same(as in the whitelist). The range can have any size
+but it must not contain more than PB_CACHE_SLOTS numbers.
+AUTH_WHITELIST as the first position means the EEPROM
+whitelist is used instead, see IsWhitelisted().
+
+phone_number:         phone number string which should be checked
+first_authorized_pos: initial SIM phonebook position
+last_authorized_pos:  last SIM phonebook position
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - there are more than PB_CACHE_SLOTS numbers in the range
+        -4 - GSM module has answered error(SIM busy etc.),
+             cache is not loaded
+
+        OK ret val:
+        -----------
+        0 - phone number is not authorized
+        1 - phone number is authorized
+
+
+an example of usage:
+        GSM gsm;
+
+        if (1 == gsm.IsAuthorizedNumber("+420123456789", 1, 5)) {
+          // number is stored on the SIM pos. #1..#5
+        }
+**********************************************************/
+char AT::IsAuthorizedNumber(char *phone_number, byte first_authorized_pos, byte last_authorized_pos)
+{
+  char ret_val;
+  byte i;
+  byte digits;
+  byte key[PB_CACHE_KEY_LEN];
+
+  if (first_authorized_pos == AUTH_WHITELIST) return (IsWhitelisted(phone_number));
+  if (first_authorized_pos == 0 || last_authorized_pos < first_authorized_pos) return (0);
+
+  if (!pb_cache_valid
+      || pb_cache_first != first_authorized_pos
+      || pb_cache_last != last_authorized_pos) {
+    ret_val = LoadPhonebookCache(first_authorized_pos, last_authorized_pos);
+    if (ret_val < 0) return (ret_val);
+  }
+
+  digits = PhonebookCacheKey(phone_number, key);
+  if (digits == 0) return (0);
+  for (i = 0; i < pb_cache_count; i++) {
+    if (pb_cache_digits[i] == digits
+        && memcmp(pb_cache_key[i], key, PB_CACHE_KEY_LEN) == 0) return (1);
+  }
+  return (0);
+}
+
+/**********************************************************
+Method reads the range of the SIM phonebook by one command
+AT+CPBR=<first_pos>,<last_pos>
+The response is parsed line by line as it comes, so
+the whole listing doesn't have to fit to the comm_buf,
+only one line must fit there.
+
+first_pos:      first SIM phonebook position
+last_pos:       last SIM phonebook position
+callback:       function called for every entry or NULL
+phone_numbers:  array for the phone numbers or NULL
+to_cache:       1 - entries are put to the phonebook cache
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - invalid range
+        -4 - GSM module has answered error(SIM busy etc.)
+
+        OK ret val:
+        -----------
+        0.. number of read entries
+**********************************************************/
+int AT::ReadPhonebookRange(byte first_pos, byte last_pos, pb_entry_callback_t callback,
+                           char (*phone_numbers)[PB_NUMBER_LEN+1], byte to_cache)
+{
+  int ret_val = -1;
+  int num_of_entries = 0;
+  uint16_t len = 0;
+  unsigned long prev_time;
+  byte ch;
+  byte position;
+  byte i;
+  char *p_char;
+  char *p_char1;
+
+  if (first_pos == 0 || last_pos < first_pos) return (-3);
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = -2; // no final response yet
+
+  if (phone_numbers != NULL) {
+    for (i = 0; i <= (byte)(last_pos - first_pos); i++) phone_numbers[i][0] = 0x00;
+  }
+
+  //send "AT+CPBR=XY,ZW"
+  outSerial.print(F("AT+CPBR="));
+  outSerial.print((int)first_pos);
+  outSerial.print(F(","));
+  outSerial.print((int)last_pos);
+  outSerial.print(F("\r"));
+
+  // response:
+  // <CR><LF>+CPBR: <index>,<number>,<type>,<text><CR><LF>
+  // ... for every stored entry
+  // <CR><LF>OK<CR><LF>
+  prev_time = millis();
+  while ((unsigned long)(millis() - prev_time) < START_XLONG_COMM_TMOUT) {
+    if (!outSerial.available()) continue;
+    ch = outSerial.read();
+    prev_time = millis(); // timeout is measured from the last character
+
+    if (ch != '\n') {
+      // store line to the comm_buf, too long line is cut
+      if (ch != '\r' && len < COMM_BUF_LEN) comm_buf[len++] = ch;
+      continue;
+    }
+
+    // whole line received
+    comm_buf[len] = 0x00;
+    comm_buf_len = len;
+    len = 0;
+
+    if (strncmp((char *)comm_buf, "+CPBR:", 6) == 0) {
+      position = atoi((char *)comm_buf + 6);
+      p_char = strchr((char *)comm_buf, '"');
+      if (p_char == NULL || position < first_pos || position > last_pos) continue;
+      p_char++;       // we are on the first phone number character
+      p_char1 = strchr(p_char, '"');
+      if (p_char1 != NULL) *p_char1 = 0x00;
+      if (strlen(p_char) > PB_NUMBER_LEN) p_char[PB_NUMBER_LEN] = 0x00;
+
+      if (callback != NULL) callback(position, p_char);
+      if (phone_numbers != NULL) strcpy(phone_numbers[position - first_pos], p_char);
+      if (to_cache) PhonebookCacheAdd(p_char);
+      num_of_entries++;
+    }
+    else if (strncmp((char *)comm_buf, "OK", 2) == 0) {
+      ret_val = num_of_entries;
+      break;
+    }
+    else if (IsErrorLine((char *)comm_buf)) {
+      // empty range is reported as +CME ERROR: 22(not found),
+      // other errors mean the range was not read
+      p_char = (char *)comm_buf + 11;
+      if (strncmp((char *)comm_buf, "+CME ERROR:", 11) == 0
+          && (atoi(p_char) == 22 || strstr(p_char, "not found") != NULL)) {
+        ret_val = num_of_entries;
+      }
+      else ret_val = -4;
+      break;
+    }
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads phone numbers from the range of SIM phonebook
+positions by one command and calls the callback function
+for every stored entry. It is much faster than calling
+GetPhoneNumber() for every position.
+
+first_pos:  first SIM phonebook position
+last_pos:   last SIM phonebook position
+callback:   function called for every stored entry,
+            phone number string is valid only inside the callback
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - invalid range
+        -4 - GSM module has answered error(SIM busy etc.)
+
+        OK ret val:
+        -----------
+        0.. number of read entries
+
+
+an example of usage:
+        void PhonebookEntry(byte position, char *phone_number)
+        {
+          ...
+        }
+
+        gsm.GetPhoneNumbers(1, 50, PhonebookEntry);
+**********************************************************/
+int AT::GetPhoneNumbers(byte first_pos, byte last_pos, pb_entry_callback_t callback)
+{
+  return (ReadPhonebookRange(first_pos, last_pos, callback, NULL, 0));
+}
+
+/**********************************************************
+Method reads phone numbers from the range of SIM phonebook
+positions by one command to the array
+
+first_pos:      first SIM phonebook position
+last_pos:       last SIM phonebook position
+phone_numbers:  array with (last_pos - first_pos + 1) items,
+                item for the empty position is empty string
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - invalid range
+        -4 - GSM module has answered error(SIM busy etc.)
+
+        OK ret val:
+        -----------
+        0.. number of read entries
+
+
+an example of usage:
+        GSM gsm;
+        char numbers[5][PB_NUMBER_LEN+1];
+
+        gsm.GetPhoneNumbers(1, 5, numbers);
+        // numbers[0] is the phone number from the SIM pos. #1
+**********************************************************/
+int AT::GetPhoneNumbers(byte first_pos, byte last_pos, char (*phone_numbers)[PB_NUMBER_LEN+1])
+{
+  return (ReadPhonebookRange(first_pos, last_pos, NULL, phone_numbers, 0));
+}
+
+/**********************************************************
+Method writes one byte to the EEPROM only if the value
+differs from the stored one (saves EEPROM write cycles)
+**********************************************************/
+void AT::EEPROMUpdate(int addr, byte value)
+{
+  if (eeprom_read_byte((uint8_t *)addr) != value) {
+    eeprom_write_byte((uint8_t *)addr, value);
+  }
+}
+
+// status byte values of the whitelist item
+#define WL_ITEM_FREE      0xFF  // erased EEPROM
+#define WL_ITEM_DELETED   0xFE
+
+#define WL_ITEM_ADDR(slot) (WL_EEPROM_ADDR + (int)(slot) * WL_ITEM_SIZE)
+#define WL_DIGIT(bcd, i)   (((bcd)[(i) >> 1] >> (((i) & 1) << 2)) & 0x0F)
+
+/**********************************************************
+Method converts phone number string to the canonical form:
+only digits are taken and max. WL_NUMBER_DIGITS last digits
+are packed to BCD, the last digit first. So "+306912345678",
+"00306912345678" and "6912345678" have the same beginning
+of the BCD array and suffix matching is simple comparison.
+
+bcd: buffer with WL_NUMBER_DIGITS/2 bytes
+
+return: number of stored digits
+**********************************************************/
+byte AT::WLNormalize(char *phone_number, byte *bcd)
+{
+  byte digits = 0;
+  char *p_char;
+
+  memset(bcd, 0, WL_NUMBER_DIGITS / 2);
+  p_char = phone_number + strlen(phone_number);
+  while (p_char > phone_number && digits < WL_NUMBER_DIGITS) {
+    p_char--;
+    if (*p_char < '0' || *p_char > '9') continue;
+    bcd[digits >> 1] |= (*p_char - '0') << ((digits & 1) << 2);
+    digits++;
+  }
+  return (digits);
+}
+
+/**********************************************************
+Method finds the number in the whitelist
+Items are placed in the EEPROM by the hash of the last
+WL_MATCH_DIGITS digits(open addressing, linear probing),
+so usually only one item is read.
+
+bcd:        canonical number from WLNormalize()
+digits:     number of digits
+free_slot:  first free item in the probe sequence is placed
+            here(-1 = no free item), can be NULL
+
+return: item index or -1 if not found
+**********************************************************/
+int AT::WLFind(byte *bcd, byte digits, int *free_slot)
+{
+  byte match_digits;
+  byte item_digits;
+  byte i;
+  byte j;
+  byte slot;
+  byte status;
+  byte item_bcd[WL_NUMBER_DIGITS / 2];
+  uint16_t hash = 0;
+  int addr;
+
+  if (free_slot != NULL) *free_slot = -1;
+  match_digits = (digits < WL_MATCH_DIGITS) ? digits : WL_MATCH_DIGITS;
+  for (i = 0; i < match_digits; i++) hash = hash * 31 + WL_DIGIT(bcd, i) + 1;
+
+  slot = hash % WL_SLOTS;
+  for (i = 0; i < WL_SLOTS; i++) {
+    addr = WL_ITEM_ADDR(slot);
+    status = eeprom_read_byte((uint8_t *)addr);
+    if (status == WL_ITEM_FREE || status == WL_ITEM_DELETED) {
+      if (free_slot != NULL && *free_slot < 0) *free_slot = slot;
+      if (status == WL_ITEM_FREE) break;  // end of the probe sequence
+    }
+    else {
+      item_digits = (status < WL_MATCH_DIGITS) ? status : WL_MATCH_DIGITS;
+      if (item_digits == match_digits) {
+        for (j = 0; j < (match_digits + 1) / 2; j++) {
+          item_bcd[j] = eeprom_read_byte((uint8_t *)(addr + 1 + j));
+        }
+        for (j = 0; j < match_digits; j++) {
+          if (WL_DIGIT(bcd, j) != WL_DIGIT(item_bcd, j)) break;
+        }
+        if (j == match_digits) return (slot);
+      }
+    }
+    slot = (slot + 1) % WL_SLOTS;
+  }
+  return (-1);
+}
+
+/**********************************************************
+Method adds phone number to the EEPROM whitelist
+The whitelist is independent on the SIM card and checking
+of the number doesn't need any communication with
+the GSM module.
+
+phone_number: phone number string, any format
+              ("+420123456789", "00420123456789", "123 456 789")
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - whitelist is full
+        -3 - there are no digits in the phone number
+
+        OK ret val:
+        -----------
+        1 - phone number was added or it was already there
+
+
+an example of usage:
+        GSM gsm;
+
+        gsm.AddToWhitelist("+420123456789");
+**********************************************************/
+char AT::AddToWhitelist(char *phone_number)
+{
+  byte bcd[WL_NUMBER_DIGITS / 2];
+  byte digits;
+  byte i;
+  int slot;
+  int free_slot;
+
+  digits = WLNormalize(phone_number, bcd);
+  if (digits == 0) return (-3);
+
+  slot = WLFind(bcd, digits, &free_slot);
+  if (slot < 0) slot = free_slot;
+  if (slot < 0) return (-1);
+
+  // digits first, status byte as the last one
+  EEPROMUpdate(WL_ITEM_ADDR(slot), WL_ITEM_DELETED);
+  for (i = 0; i < WL_NUMBER_DIGITS / 2; i++) {
+    EEPROMUpdate(WL_ITEM_ADDR(slot) + 1 + i, bcd[i]);
+  }
+  EEPROMUpdate(WL_ITEM_ADDR(slot), digits);
+  return (1);
+}
+
+/**********************************************************
+Method removes phone number from the EEPROM whitelist
+
+phone_number: phone number string
+
+return:
+        0 - phone number was not found
+        1 - phone number was removed
+**********************************************************/
+char AT::RemoveFromWhitelist(char *phone_number)
+{
+  byte bcd[WL_NUMBER_DIGITS / 2];
+  byte digits;
+  int slot;
+
+  digits = WLNormalize(phone_number, bcd);
+  if (digits == 0) return (0);
+  slot = WLFind(bcd, digits, NULL);
+  if (slot < 0) return (0);
+  EEPROMUpdate(WL_ITEM_ADDR(slot), WL_ITEM_DELETED);
+  return (1);
+}
+
+/**********************************************************
+Method removes all phone numbers from the EEPROM whitelist
+**********************************************************/
+void AT::ClearWhitelist(void)
+{
+  byte slot;
+
+  for (slot = 0; slot < WL_SLOTS; slot++) {
+    EEPROMUpdate(WL_ITEM_ADDR(slot), WL_ITEM_FREE);
+  }
+}
+
+/**********************************************************
+Method checks if the phone number is in the EEPROM whitelist
+Numbers are compared by the last WL_MATCH_DIGITS digits so
+"+306912345678", "00306912345678" and "6912345678" match.
+
+The same check is used by GetAuthorizedSMS() and
+CallStatusWithAuth() if AUTH_WHITELIST is used as the
+authorized range.
+
+phone_number: phone number string
+
+return:
+        0 - phone number is not in the whitelist
+        1 - phone number is in the whitelist
+
+
+an example of usage:
+        GSM gsm;
+
+        if (gsm.IsWhitelisted(phone_num)) ...
+        // or
+        gsm.GetAuthorizedSMS(1, phone_num, sms_text, 100,
+                             AUTH_WHITELIST, AUTH_WHITELIST);
+**********************************************************/
+char AT::IsWhitelisted(char *phone_number)
+{
+  byte bcd[WL_NUMBER_DIGITS / 2];
+  byte digits;
+
+  digits = WLNormalize(phone_number, bcd);
+  if (digits == 0) return (0);
+  return (WLFind(bcd, digits, NULL) >= 0);
+}
+
+// number of bytes of the UTF-8 sequence by the upper nibble of the lead byte
+// 0 - continuation byte, not valid as the lead byte
+static const byte utf8_seq_len[] PROGMEM = {1,1,1,1,1,1,1,1, 0,0,0,0, 2,2,3,4};
+
+/**********************************************************
+Method converts UCS2 hex string (UTF-16 big endian code units
+as 4 hex digits, e.g. "00480069") to UTF-8 in place
+UTF-8 is never longer than the hex string, so the same buffer
+is used for the output.
+
+str:      hex string
+hex_len:  number of hex characters to convert, number of
+          converted hex characters is placed here - it can be
+          less if the string ends with an incomplete character
+          (then the rest should be converted with the next data)
+
+return: length of the UTF-8 string (not finished by 0x00)
+
+
+an example of usage:
+        char text[] = "004100680065006A";
+        uint16_t hex_len = strlen(text);
+
+        text[gsm.UCS2ToUTF8(text, &hex_len)] = 0;
+**********************************************************/
+uint16_t AT::UCS2ToUTF8(char *str, uint16_t *hex_len)
+{
+  uint16_t in = 0;
+  uint16_t out = 0;
+  uint32_t code;
+  uint16_t unit;
+  byte units;
+  byte high;
+  byte low;
+
+  while (in + 4 <= *hex_len) {
+    // UTF-16 code unit - invalid hex digits give U+FFFD
+    if (HexToByte(str + in, &high) && HexToByte(str + in + 2, &low)) {
+      code = ((uint16_t)high << 8) | low;
+    }
+    else code = 0xFFFD;
+    units = 1;
+    if (code >= 0xD800 && code <= 0xDBFF) {
+      // high surrogate - the next code unit is necessary
+      if (in + 8 > *hex_len) break;  // convert it with the next data
+      unit = 0;
+      if (HexToByte(str + in + 4, &high) && HexToByte(str + in + 6, &low)) {
+        unit = ((uint16_t)high << 8) | low;
+      }
+      if (unit >= 0xDC00 && unit <= 0xDFFF) {
+        code = 0x10000 + ((code - 0xD800) << 10) + (unit - 0xDC00);
+        units = 2;
+      }
+      else code = 0xFFFD;
+    }
+    else if (code >= 0xDC00 && code <= 0xDFFF) code = 0xFFFD;
+
+    // output is always shorter than the input
+    if (code < 0x80) {
+      str[out++] = code;
+    }
+    else if (code < 0x800) {
+      str[out++] = 0xC0 | (code >> 6);
+      str[out++] = 0x80 | (code & 0x3F);
+    }
+    else if (code < 0x10000) {
+      str[out++] = 0xE0 | (code >> 12);
+      str[out++] = 0x80 | ((code >> 6) & 0x3F);
+      str[out++] = 0x80 | (code & 0x3F);
+    }
+    else {
+      str[out++] = 0xF0 | (code >> 18);
+      str[out++] = 0x80 | ((code >> 12) & 0x3F);
+      str[out++] = 0x80 | ((code >> 6) & 0x3F);
+      str[out++] = 0x80 | (code & 0x3F);
+    }
+    in += units * 4;
+  }
+
+  *hex_len = in;
+  return (out);
+}
+
+/**********************************************************
+Method sends UTF-8 string to the GSM module as UCS2 hex string
+Characters outside of the basic plane are sent as UTF-16
+surrogate pairs, invalid UTF-8 bytes as U+FFFD.
+String is converted on the fly so no buffer is necessary.
+
+str: UTF-8 string finished by 0x00
+**********************************************************/
+void AT::SendUCS2Hex(char *str)
+{
+  uint32_t code;
+  uint16_t unit[2];
+  byte seq_len;
+  byte ch;
+  byte i;
+  byte j;
+
+  while (*str) {
+    ch = *str++;
+    seq_len = pgm_read_byte(&utf8_seq_len[ch >> 4]);
+    if (seq_len == 0) {
+      code = 0xFFFD;
+    }
+    else {
+      // payload bits of the lead byte
+      code = ch & (0x7F >> seq_len);
+      if (seq_len == 1) code = ch;
+      for (i = 1; i < seq_len; i++) {
+        if ((*str & 0xC0) != 0x80) {
+          code = 0xFFFD;  // truncated sequence
+          break;
+        }
+        code = (code << 6) | (*str++ & 0x3F);
+      }
+    }
+
+    if (code >= 0x10000) {
+      code -= 0x10000;
+      unit[0] = 0xD800 | (code >> 10);
+      unit[1] = 0xDC00 | (code & 0x3FF);
+      j = 2;
+    }
+    else {
+      unit[0] = code;
+      j = 1;
+    }
+    for (i = 0; i < j; i++) {
+      WriteHexByte(unit[i] >> 8);
+      WriteHexByte(unit[i] & 0xFF);
+    }
+  }
+}
+
+/**********************************************************
+Method sends SMS with UCS2 data coding
+Character set of the GSM module is switched to "UCS2"
+(and back to "IRA" before the method returns)
+(AT+CSCS) so the phone number as well as the text are sent
+as UCS2 hex strings. Text can contain any characters,
+max. 70 characters fit to one SMS.
+
+number_str:   pointer to the phone number string
+message_str:  pointer to the SMS text string in UTF-8
+
+return: 
+        the same as SendSMS()
+
+
+an example of usage:
+        GSM gsm;
+        gsm.SendSMSUCS2("00XXXYYYYYYYYY", "Teplota 25 \xC2\xB0" "C");
+**********************************************************/
+char AT::SendSMSUCS2(char *number_str, char *message_str)
+{
+  char ret_val = -1;
+  byte i;
+#ifndef DEBUG_SMS_ENABLED
+  char *p_char;
+#endif
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = 0; // still not send
+  lastSMSRef = -1;
+  if (AT_RESP_OK != SelectSMSMode(SMS_MODE_TEXT_UCS2)) {
+    SelectSMSMode(SMS_MODE_TEXT);
+    SetCommLineStatus(CLS_FREE);
+    return (ret_val);
+  }
+
+  // try to send SMS 3 times in case there is some problem
+  for (i = 0; i < 3; i++) {
+    // send  AT+CMGS="number_str" - number is also UCS2 hex string
+    outSerial.print(F("AT+CMGS=\""));
+    SendUCS2Hex(number_str);
+    outSerial.print(F("\"\r"));
+
+    if (RX_FINISHED_STR_RECV == WaitResp(START_LONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, ">")) {
+      // send SMS text
+      SendUCS2Hex(message_str);
+
+#ifdef DEBUG_SMS_ENABLED
+      // SMS will not be sent = we will not pay => good for debugging
+      outSerial.write(27);
+      if (RX_FINISHED_STR_RECV == WaitResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK")) {
+#else 
+      outSerial.write(26);
+      if (RX_FINISHED_STR_RECV == WaitResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CMGS")) {
+        // response: +CMGS: <mr>
+        p_char = strchr((char *)comm_buf, ':');
+        if (p_char != NULL) lastSMSRef = atoi(p_char + 1);
+#endif
+        // SMS was send correctly 
+        ret_val = 1;
+        break;
+      }
+    }
+  }
+
+  // phonebook and +CLCC expect "IRA" character set
+  SelectSMSMode(SMS_MODE_TEXT);
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads SMS in the UCS2 character set
+The phone number and the SMS text are converted from UCS2
+hex strings to UTF-8 in place in the comm_buf, so SMS with
+any characters(e.g. sent from phones which switched to UCS2
+because of one national character) are read as normal text.
+Character set is switched back to "IRA" before the method returns.
+
+Parameters and return values are the same as for GetSMS(),
+keep in mind that one national character takes 2-3 bytes
+of the SMS_text buffer in UTF-8.
+**********************************************************/
+char AT::GetSMSUCS2(byte position, char *phone_number, char *SMS_text, byte max_SMS_len)
+{
+  return (RcvSMS(position, phone_number, NULL, SMS_text, max_SMS_len, SMS_MODE_TEXT_UCS2));
+}
+
+/**********************************************************
+Method reads SMS in the UCS2 character set and passes
+the text converted to UTF-8 to the sink function
+Parameters and return values are the same as for GetSMSStream().
+**********************************************************/
+char AT::GetSMSStreamUCS2(byte position, char *phone_number, sms_sink_t sink)
+{
+  return (RcvSMS(position, phone_number, sink, NULL, 0, SMS_MODE_TEXT_UCS2));
+}
+
+/**********************************************************
+Method parses the +CPMS: response in the comm_buf
+Set command response:
++CPMS: <used1>,<total1>,<used2>,<total2>,<used3>,<total3>
+Read command response:
++CPMS: <mem1>,<used1>,<total1>,<mem2>,<used2>,<total2>,<mem3>,<used3>,<total3>
+
+return: 
+        0 - +CPMS: was not found
+        1 - counters are updated
+**********************************************************/
+char AT::ParseCPMS(void)
+{
+  char *p_char;
+  byte i;
+
+  p_char = strstr((char *)comm_buf, "+CPMS:");
+  if (p_char == NULL) return (0);
+  p_char += 6;
+
+  for (i = 0; i < SMS_MEM_LAST_ITEM; i++) {
+    while (*p_char == ' ') p_char++;
+    if (*p_char == '"') {
+      // storage name
+      if (strncmp(p_char, "\"ME\"", 4) == 0) smsMemStorage = SMS_STORAGE_ME;
+      else if (strncmp(p_char, "\"SM\"", 4) == 0) smsMemStorage = SMS_STORAGE_SM;
+      p_char = strchr(p_char, ',');
+      if (p_char == NULL) return (0);
+      p_char++;
+    }
+    smsMemUsed[i] = atoi(p_char);
+    p_char = strchr(p_char, ',');
+    if (p_char == NULL) return (0);
+    smsMemTotal[i] = atoi(p_char + 1);
+    p_char = strchr(p_char + 1, ',');
+    if (p_char == NULL) break;
+    p_char++;
+  }
+  return (1);
+}
+
+/**********************************************************
+Method selects storage for all SMS operations
+AT+CPMS="SM","SM","SM" or AT+CPMS="ME","ME","ME"
+
+!!This function is used internally when the comm. line
+is already reserved(CLS_ATCMD)
+
+return: 
+        0 - storage was not selected
+        1 - storage was selected, counters are updated
+**********************************************************/
+char AT::SendCPMS(byte storage)
+{
+  char ret_val;
+
+  if (storage == SMS_STORAGE_ME) {
+    ret_val = SendATCmdWaitResp("AT+CPMS=\"ME\",\"ME\",\"ME\"", START_LONG_COMM_TMOUT, START_LONG_COMM_TMOUT, "+CPMS:", 10);
+  }
+  else {
+    ret_val = SendATCmdWaitResp("AT+CPMS=\"SM\",\"SM\",\"SM\"", START_LONG_COMM_TMOUT, START_LONG_COMM_TMOUT, "+CPMS:", 10);
+  }
+  if (AT_RESP_OK == ret_val) {
+    smsMemStorage = storage;
+    ParseCPMS();
+    return (1);
+  }
+  return (0);
+}
+
+/**********************************************************
+Method reads counters of the SMS storages(AT+CPMS?) and
+applies the overflow policy set by SetSMSMemPolicy()
+in case there are SMS_MEM_RESERVE or less free positions
+for received SMS:
+
+SMS_MEM_POLICY_NONE      - nothing, only counters are updated
+SMS_MEM_POLICY_DRAIN     - already read SMS are deleted(AT+CMGD=1,1)
+SMS_MEM_POLICY_SWITCH_ME - storage is switched from the SIM card
+                           to the GSM module memory("ME") so next
+                           SMS are not rejected, if "ME" is almost
+                           full too read SMS are deleted there
+                           (SMS left in the SIM are not visible until
+                           InitSMSMemory() is called again)
+
+Method should be called regularly e.g. together with
+CheckRegistration() so the storage is never full
+and incoming SMS are not rejected.
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+
+        OK ret val:
+        -----------
+        0..127 number of free positions for received SMS
+
+
+an example of usage:
+        GSM gsm;
+
+        gsm.SetSMSMemPolicy(SMS_MEM_POLICY_SWITCH_ME);
+        ...
+        gsm.CheckSMSMemory();
+        // gsm.smsMemUsed[SMS_MEM_RECV] of gsm.smsMemTotal[SMS_MEM_RECV]
+**********************************************************/
+char AT::CheckSMSMemory(void)
+{
+  char ret_val = -1;
+  int free_pos;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+
+  // response: +CPMS: "SM",3,50,"SM",3,50,"SM",3,50
+  if (AT_RESP_OK != SendATCmdWaitResp("AT+CPMS?", START_LONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CPMS:", 2)) {
+    SetCommLineStatus(CLS_FREE);
+    return (-2);
+  }
+  ParseCPMS();
+
+  free_pos = smsMemTotal[SMS_MEM_RECV] - smsMemUsed[SMS_MEM_RECV];
+  if (smsMemTotal[SMS_MEM_RECV] && free_pos <= SMS_MEM_RESERVE) {
+    if (sms_mem_policy == SMS_MEM_POLICY_SWITCH_ME && smsMemStorage != SMS_STORAGE_ME) {
+      SendCPMS(SMS_STORAGE_ME);
+    }
+    else if (sms_mem_policy != SMS_MEM_POLICY_NONE) {
+      // delete all read SMS from the current storage
+      SendATCmdWaitResp("AT+CMGD=1,1", START_XLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", 1);
+      if (AT_RESP_OK == SendATCmdWaitResp("AT+CPMS?", START_LONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CPMS:", 2)) {
+        ParseCPMS();
+      }
+    }
+    free_pos = smsMemTotal[SMS_MEM_RECV] - smsMemUsed[SMS_MEM_RECV];
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  if (free_pos < 0) free_pos = 0;
+  if (free_pos > 127) free_pos = 127;
+  return (free_pos);
+}
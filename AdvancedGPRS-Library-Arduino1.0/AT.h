@@ -95,6 +95,60 @@ GSM module and thus can be interpreted as AT commands.
 	#define AT_DELAY                        500
 #endif // end of ifndef AT_DELAY
 
+// max. length of the phone number string read from the phonebook
+// (excluding 0x00 termination)
+#ifndef PB_NUMBER_LEN
+	#define PB_NUMBER_LEN                   19
+#endif // end of ifndef PB_NUMBER_LEN
+
+// EEPROM whitelist of authorized numbers
+// first EEPROM address used by the whitelist
+// (must not overlap with other EEPROM areas, e.g. SMS_QUEUE_EEPROM_ADDR..)
+#ifndef WL_EEPROM_ADDR
+	#define WL_EEPROM_ADDR                  800
+#endif // end of ifndef WL_EEPROM_ADDR
+
+// max. number of numbers in the whitelist
+#ifndef WL_SLOTS
+	#define WL_SLOTS                        16
+#endif // end of ifndef WL_SLOTS
+
+// max. number of digits stored for one number (even number)
+#ifndef WL_NUMBER_DIGITS
+	#define WL_NUMBER_DIGITS                16
+#endif // end of ifndef WL_NUMBER_DIGITS
+
+// numbers match if their last WL_MATCH_DIGITS digits are the same
+// (shorter numbers must match completely)
+#ifndef WL_MATCH_DIGITS
+	#define WL_MATCH_DIGITS                 9
+#endif // end of ifndef WL_MATCH_DIGITS
+
+// one whitelist item: <number of digits><BCD digits, the last digit first>
+#define WL_ITEM_SIZE        (1 + WL_NUMBER_DIGITS / 2)
+#define WL_EEPROM_END       (WL_EEPROM_ADDR + WL_SLOTS * WL_ITEM_SIZE)
+
+// overflow policy of CheckSMSMemory() is applied when there are
+// only SMS_MEM_RESERVE or less free positions in the SMS storage
+#ifndef SMS_MEM_RESERVE
+	#define SMS_MEM_RESERVE                 3
+#endif // end of ifndef SMS_MEM_RESERVE
+
+// max. number of status reports(+CDS) collected from the responses
+// of AT commands until they are read by CheckDeliveryReports()
+#ifndef CDS_PENDING_SLOTS
+	#define CDS_PENDING_SLOTS               4
+#endif // end of ifndef CDS_PENDING_SLOTS
+
+// number of items of the phonebook cache used for authorization
+// = max. number of phone numbers stored in the authorized range
+// of the SIM phonebook, IsAuthorizedNumber() returns -3 if there
+// are more(each item takes 1 + (WL_MATCH_DIGITS + 1) / 2 bytes of RAM)
+#ifndef PB_CACHE_SLOTS
+	#define PB_CACHE_SLOTS                  16
+#endif // end of ifndef PB_CACHE_SLOTS
+#define PB_CACHE_KEY_LEN    ((WL_MATCH_DIGITS + 1) / 2)
+
 
 // some constants for the IsRxFinished() method
 #define RX_NOT_STARTED      0
@@ -111,6 +165,60 @@ enum sms_type_enum
   SMS_LAST_ITEM
 };
 
+// SMS message format
+// used by method SelectSMSMode(), values PDU and TEXT are the same as for AT+CMGF
+enum sms_mode_enum
+{
+  SMS_MODE_PDU = 0,
+  SMS_MODE_TEXT,
+  SMS_MODE_TEXT_UCS2, // text mode, strings are UCS2 hex (AT+CSCS="UCS2")
+  SMS_MODE_UNKNOWN,
+
+  SMS_MODE_LAST_ITEM
+};
+
+// authorization by the EEPROM whitelist instead of the SIM phonebook range
+// use as first_authorized_pos and last_authorized_pos
+#define AUTH_WHITELIST                      255
+
+// sink for the GetSMSStream() - called for every chunk of the SMS text
+typedef void (*sms_sink_t)(char *chunk, byte len);
+
+// callback for the GetPhoneNumbers() - called for every phonebook entry
+typedef void (*pb_entry_callback_t)(byte position, char *phone_number);
+
+// SMS storages in the +CPMS: response
+// used as index to the smsMemUsed[] and smsMemTotal[]
+enum sms_mem_enum
+{
+  SMS_MEM_READ = 0,   // <mem1> - read and delete
+  SMS_MEM_WRITE,      // <mem2> - write and send
+  SMS_MEM_RECV,       // <mem3> - received SMS are stored here
+
+  SMS_MEM_LAST_ITEM
+};
+
+// SMS storage
+enum sms_storage_enum
+{
+  SMS_STORAGE_SM = 0, // SIM card
+  SMS_STORAGE_ME,     // GSM module memory
+  SMS_STORAGE_UNKNOWN,
+
+  SMS_STORAGE_LAST_ITEM
+};
+
+// what CheckSMSMemory() does when the storage is almost full
+enum sms_mem_policy_enum
+{
+  SMS_MEM_POLICY_NONE = 0,  // only counters are updated
+  SMS_MEM_POLICY_DRAIN,     // already read SMS are deleted
+  SMS_MEM_POLICY_SWITCH_ME, // storage is switched from SIM to "ME",
+                            // read SMS are deleted if "ME" is almost full too
+
+  SMS_MEM_POLICY_LAST_ITEM
+};
+
 enum comm_line_status_enum 
 {
   // CLS like CommunicationLineStatus
@@ -199,6 +307,10 @@ class AT
   public:
     uint16_t comm_buf_len;          // num. of characters in the buffer
     byte comm_buf[COMM_BUF_LEN+1];  // communication buffer +1 for 0x00 termination
+    int lastSMSRef;                 // message reference of the last sent SMS, -1 = unknown
+    byte smsMemStorage;             // SMS_STORAGE_... used for all SMS storages
+    byte smsMemUsed[SMS_MEM_LAST_ITEM];   // number of SMS in the storages
+    byte smsMemTotal[SMS_MEM_LAST_ITEM];  // capacity of the storages
     
 
     // library version
@@ -219,7 +331,10 @@ class AT
     // serial line initialization
     void InitSerLine(long baud_rate);
     // set comm. line status
-    inline void SetCommLineStatus(byte new_status) {comm_line_status = new_status;};
+    inline void SetCommLineStatus(byte new_status) {
+      comm_line_status = new_status;
+      if (new_status == CLS_ATCMD) comm_line_used = 1;
+    };
     // get comm. line status
     inline byte GetCommLineStatus(void) {return comm_line_status;};
     
@@ -230,10 +345,21 @@ class AT
 	
     // SMS's methods 
     char InitSMSMemory(void);
+    char CheckSMSMemory(void);
+    inline void SetSMSMemPolicy(byte policy) {sms_mem_policy = policy;};
+    char SelectSMSMode(byte mode);
+    char SelectSMSMode(byte mode, byte no_of_attempts);
+    char SetStatusReport(byte enable);
     char SendSMS(char *number_str, char *message_str);
     char SendSMS(byte sim_phonebook_position, char *message_str);
     char IsSMSPresent(byte required_status);
     char GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS_len);
+    char GetSMSStream(byte position, char *phone_number, sms_sink_t sink);
+    char SendSMSUCS2(char *number_str, char *message_str);
+    char GetSMSUCS2(byte position, char *phone_number, char *SMS_text, byte max_SMS_len);
+    char GetSMSStreamUCS2(byte position, char *phone_number, sms_sink_t sink);
+    uint16_t UCS2ToUTF8(char *str, uint16_t *hex_len);
+    void SendUCS2Hex(char *str);
     char GetAuthorizedSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS_len,
                           byte first_authorized_pos, byte last_authorized_pos);
     char DeleteSMS(byte position);
@@ -242,6 +368,18 @@ class AT
     char GetPhoneNumber(byte position, char *phone_number);
     char WritePhoneNumber(byte position, char *phone_number);
     char ComparePhoneNumber(byte position, char *phone_number);
+    int GetPhoneNumbers(byte first_pos, byte last_pos, pb_entry_callback_t callback);
+    int GetPhoneNumbers(byte first_pos, byte last_pos, char (*phone_numbers)[PB_NUMBER_LEN+1]);
+    char IsAuthorizedNumber(char *phone_number, byte first_authorized_pos, byte last_authorized_pos);
+    inline void InvalidatePhonebookCache(void) {pb_cache_valid = 0;};
+
+    // EEPROM whitelist methods
+    char AddToWhitelist(char *phone_number);
+    char RemoveFromWhitelist(char *phone_number);
+    void ClearWhitelist(void);
+    char IsWhitelisted(char *phone_number);
+
+    void EEPROMUpdate(int addr, byte value);
 
 
     // routines regarding communication with the device
@@ -249,9 +387,12 @@ class AT
                 byte flush_before_read, byte read_when_buffer_full);
     byte IsRxFinished(void);
     byte IsStringReceived(char const *compare_string);
+    byte IsErrorLine(char const *line);
     byte WaitResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout);
     byte WaitResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout, 
                   char const *expected_resp_string);
+    byte WaitFinalResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout, 
+                       char const *expected_resp_string);
     char SendATCmdWaitResp(char const *AT_cmd_string,
                uint16_t start_comm_tmout, uint16_t max_interchar_tmout,
                char const *response_string,
@@ -259,7 +400,48 @@ class AT
 
   private:
     byte comm_line_status;
+  protected:
+    byte comm_line_used;            // 1 - line was reserved for an AT command(CLS_ATCMD)
+    // module has default SMS format after reset, AT+CMGF must be sent again
+    inline void InvalidateSMSMode(void) {sms_mode = SMS_MODE_UNKNOWN;};
+    // status reports(<mr>, <st>) found by ScanCDS()
+    byte cds_mr[CDS_PENDING_SLOTS];
+    byte cds_st[CDS_PENDING_SLOTS];
+    byte cds_count;
+    void ScanCDS(char *p_char);
+    // hexadecimal strings(PDU, UCS2, status reports)
+    char HexNibble(char ch);
+    byte HexToByte(char *p_char, byte *value);
+    void WriteHexByte(byte value);
+  private:
 	byte batt_charge_status;
+    byte sms_mode;                  // currently selected SMS message format(AT+CMGF)
+    byte sms_ucs2;                  // 1 - UCS2 character set is selected(AT+CSCS)
+    byte csmp_fo;                   // first octet used for AT+CSMP
+    byte sms_mem_policy;            // SMS_MEM_POLICY_...
+
+    // phonebook cache - keys of the numbers from the authorized range
+    byte pb_cache_key[PB_CACHE_SLOTS][PB_CACHE_KEY_LEN];
+    byte pb_cache_digits[PB_CACHE_SLOTS];
+    byte pb_cache_count;            // numbers in the range, can be > PB_CACHE_SLOTS
+    byte pb_cache_valid;
+    byte pb_cache_first;            // authorized range loaded in the cache
+    byte pb_cache_last;
+
+    char SendCSMP(void);
+    char SendCPMS(byte storage);
+    char ParseCPMS(void);
+    char RcvSMS(byte position, char *phone_number, sms_sink_t sink,
+                char *SMS_text, byte max_SMS_len, byte mode);
+    uint16_t RcvSMSChunk(uint16_t len, sms_sink_t sink,
+                         char *SMS_text, byte max_SMS_len, byte *text_len, byte mode);
+    byte PhonebookCacheKey(char *phone_number, byte *key);
+    void PhonebookCacheAdd(char *phone_number);
+    byte WLNormalize(char *phone_number, byte *bcd);
+    int WLFind(byte *bcd, byte digits, int *free_slot);
+    int ReadPhonebookRange(byte first_pos, byte last_pos, pb_entry_callback_t callback,
+                           char (*phone_numbers)[PB_NUMBER_LEN+1], byte to_cache);
+    char LoadPhonebookCache(byte first_authorized_pos, byte last_authorized_pos);
 
     // variables connected with communication buffer
     byte *p_comm_buf;               // pointer to the communication buffer   
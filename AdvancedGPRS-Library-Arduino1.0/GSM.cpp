@@ -51,6 +51,62 @@ GSM::GSM(void)
   pinMode(GSM_ON, OUTPUT);               // sets pin 4 as output
    // not registered yet
   module_status = STATUS_NONE;
+  // no reassembly table for concatenated SMS
+  concat_table = NULL;
+  concat_slots = 0;
+  concat_ref = 0;
+  // no SMS burst queue
+  burst_queue = NULL;
+  burst_queue_len = 0;
+  burst_head = 0;
+  burst_count = 0;
+  burstSent = 0;
+  burstTime = 0;
+  // persistent SMS queue - restored by InitSMSQueue()
+  smsq_next_slot = 0;
+  smsq_next_seq = 1;
+  smsq_retry_wait = 0;
+  // no delivery report tracking table
+  dlr_table = NULL;
+  dlr_slots = 0;
+  dlrDelivered = 0;
+  dlrLatencySum = 0;
+  dlrLatencyMax = 0;
+  // new SMS notifications are disabled
+  sms_new_count = 0;
+  sms_new_notify = 0;
+  smsNewLost = 0;
+  // transparent GPRS mode, no sockets
+  gprs_mode = GPRS_MODE_TRANSPARENT;
+  gprs_dtr_pin = GPRS_NO_DTR;
+  gprs_dcd_pin = GPRS_NO_DCD;
+  gprs_escaped = 0;
+  gprs_last_tx = 0;
+  gprs_qsend = 0;
+  gprs_keep_type = TCP_SOCKET;
+  gprs_keep_port = 0;
+  gprs_keep_addr = NULL;
+  gprsConnects = 0;
+  gprs_pack_wait = GPRS_PACK_WAIT;
+  gprs_pack_size = GPRS_PACK_SIZE;
+  // no send buffer
+  gprs_tx_buf = NULL;
+  gprs_tx_size = 0;
+  gprs_tx_len = 0;
+  gprs_tx_tmout = 0;
+  gprs_tx_first = 0;
+  gprsTxFlushes = 0;
+  MatchInit(&gprs_carrier, "\r\nNO CARRIER\r\n");
+  gprs_carrier_seen = 0;
+  sock_table = NULL;
+  sock_num = 0;
+  sock_rx_state = SOCK_RX_LINE;
+  sock_line_done = 0;
+  sock_sink = NULL;
+  // no command reply buffer
+  cmd_reply = NULL;
+  cmd_reply_size = 0;
+  cmd_reply_len = 0;
   
  }
 
@@ -129,6 +185,9 @@ void GSM::InitParam(byte group)
       SendATCmdWaitResp("AT&F0", 1000, 20, "OK", 5);      
       // switch off echo
       SendATCmdWaitResp("ATE0", 500, 20, "OK", 5);
+      // errors with codes(+CME ERROR: <err>), e.g. empty phonebook
+      // range is distinguished from the SIM failure
+      SendATCmdWaitResp("AT+CMEE=1", 500, 20, "OK", 5);
       // setup auto baud rate
       SendATCmdWaitResp("AT+IPR=0", 500, 20, "OK", 5);
       SetCommLineStatus(CLS_FREE);
@@ -140,11 +199,13 @@ void GSM::InitParam(byte group)
       SetCommLineStatus(CLS_ATCMD);
 
       // set the SMS mode to text 
-      SendATCmdWaitResp("AT+CMGF=1", 500, 20, "OK", 5);
-      // init SMS storage
-      InitSMSMemory();
+      InvalidateSMSMode();
+      SelectSMSMode(SMS_MODE_TEXT, 5);
       // select phonebook memory storage
       SendATCmdWaitResp("AT+CPBS=\"SM\"", 1000, 20, "OK", 5);
+      // init SMS storage - it reserves the comm. line itself
+      SetCommLineStatus(CLS_FREE);
+      InitSMSMemory();
       break;
   }
   
@@ -310,7 +371,6 @@ byte GSM::CallStatusWithAuth(char *phone_number,
 {
   byte ret_val = CALL_NONE;
   byte search_phone_num = 0;
-  byte i;
   byte status;
   char *p_char; 
   char *p_char1;
@@ -417,15 +477,12 @@ byte GSM::CallStatusWithAuth(char *phone_number,
           // make authorization
           // ------------------
           SetCommLineStatus(CLS_FREE);
-          for (i = first_authorized_pos; i <= last_authorized_pos; i++) {
-            if (ComparePhoneNumber(i, phone_number)) {
-              // phone numbers are identical
-              // authorization is OK
-              // ---------------------------
-              if (ret_val == CALL_INCOM_VOICE_NOT_AUTH) ret_val = CALL_INCOM_VOICE_AUTH;
-              else ret_val = CALL_INCOM_DATA_AUTH;
-              break;  // and finish authorization
-            }
+          if (1 == IsAuthorizedNumber(phone_number, first_authorized_pos, last_authorized_pos)) {
+            // phone number is in the authorized range
+            // authorization is OK
+            // ---------------------------------------
+            if (ret_val == CALL_INCOM_VOICE_NOT_AUTH) ret_val = CALL_INCOM_VOICE_AUTH;
+            else ret_val = CALL_INCOM_DATA_AUTH;
           }
         }
       }
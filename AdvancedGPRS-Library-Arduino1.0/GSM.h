@@ -50,6 +50,9 @@
 
 #include "AT.h"
 #include "GSM_GPRS.h"
+#include "GSM_PDU.h"
+#include "GSM_SMS.h"
+#include "GSM_CMD.h"
 
 
 
@@ -162,15 +165,134 @@ class GSM : public AT
     //=================================================================
     int GPRSLibVer(void);
     char InitGPRS(char* apn, char* login, char* password);
+    char InitGPRS(char* apn, char* login, char* password, byte mode);
     char EnableGPRS(byte open_mode);
     char DisableGPRS(void);
     char OpenSocket(byte socket_type, uint16_t remote_port, char* remote_addr);
     char CloseSocket(void);
+    char KeepSocket(byte socket_type, uint16_t remote_port, char* remote_addr);
+    char CheckSocket(void);
+    char InitFastEscape(byte dtr_pin);
+    char InitCarrierDetect(byte dcd_pin);
+    char LeaveDataMode(void);
+    char ReturnToDataMode(void);
     void SendData(char* str_data);
     void SendData(byte* data_buffer, unsigned short size);
+    void SendData(gprs_seg_t *segs, byte num_of_segs);
+    char InitSendBuffer(byte *buffer, uint16_t size, uint16_t flush_tmout);
+    uint16_t BufferData(char* str_data);
+    uint16_t BufferData(byte* data_buffer, uint16_t size);
+    uint16_t FlushData(void);
+    void PollSendBuffer(void);
     uint16_t RcvData(uint16_t start_comm_tmout, uint16_t max_interchar_tmout, byte** ptr_to_rcv_data);
     signed short StrInBin(byte* p_bin_data, char* p_string_to_search, unsigned short size);
 
+    void InitSockets(gprs_socket_t *table, byte num_of_sockets);
+    char SocketOpen(byte socket_type, uint16_t remote_port, char* remote_addr);
+    char SocketClose(byte socket);
+    int SocketSend(byte socket, byte* data_buffer, uint16_t size);
+    int SocketSend(byte socket, gprs_seg_t *segs, byte num_of_segs);
+    uint16_t SocketRead(byte socket, byte* data_buffer, uint16_t max_size);
+    uint16_t SocketAvailable(byte socket);
+    byte SocketState(byte socket);
+    char PollSockets(void);
+    void SetSocketSink(gprs_sink_t sink);
+    char SetSocketFlowControl(byte enable);
+    void SocketResume(byte socket);
+    char SetQuickSend(byte enable);
+    long SocketAck(byte socket);
+    uint16_t RcvDataStream(uint16_t start_comm_tmout, uint16_t max_interchar_tmout, gprs_sink_t sink);
+    void MatchInit(gprs_match_t *match, char const *delimiter);
+    byte MatchByte(gprs_match_t *match, byte ch);
+    int MatchData(gprs_match_t *match, byte *data, uint16_t len);
+    uint16_t RcvDataUntil(uint16_t start_comm_tmout, uint16_t max_interchar_tmout,
+                          byte *data_buffer, uint16_t len, gprs_match_t *delimiter);
+    uint16_t SocketReadUntil(byte socket, byte *data_buffer, uint16_t len,
+                             gprs_match_t *delimiter, uint16_t tmout);
+
+  //=================================================================
+    // SMS PDU section: implementaion of methods are placed
+    //                      in the GSM_PDU.cpp  
+    //=================================================================
+    int PDULibVer(void);
+    char SendSMSPDU(pdu_sms_t *sms, byte *data, byte data_len);
+    char SendSMSPDU(pdu_sms_t *sms, byte *data, byte data_len, byte flags);
+    char GetSMSPDU(byte position, pdu_sms_t *sms, byte *data, byte max_data_len);
+    byte PDUEncodeSubmit(byte *pdu, pdu_sms_t *sms, byte *data, byte data_len, byte flags);
+    char PDUDecode(byte *pdu, byte pdu_len, pdu_sms_t *sms, byte *data, byte max_data_len);
+    byte PDUAlphabet(byte dcs);
+    byte PackSeptets(byte *dest, byte *septets, byte num_of_septets, byte fill_bits);
+    byte UnpackSeptets(byte *septets, byte *src, byte num_of_septets, byte fill_bits);
+    byte TextToGSM7(byte *septets, char *text, byte text_len, byte max_septets);
+    byte GSM7ToText(char *text, byte *septets, byte num_of_septets);
+    byte GSM7Fit(char *text, uint16_t text_len, byte max_septets);
+
+  //=================================================================
+    // SMS section: implementaion of methods are placed
+    //                      in the GSM_SMS.cpp  
+    //=================================================================
+    int SMSLibVer(void);
+    char SendLongSMS(char *number_str, char *message_str);
+    char SendLongSMS(pdu_sms_t *sms, byte *data, uint16_t data_len);
+    void InitConcatSMS(concat_slot_t *table, byte num_of_slots);
+    char AddConcatPart(pdu_sms_t *sms, byte *data,
+                       byte *msg, uint16_t max_msg_len, uint16_t *msg_len);
+    void PurgeConcatSMS(void);
+    int SendSMSBroadcast(char **numbers, byte num_of_numbers, char *message_str);
+    void InitSMSBurst(sms_out_t *queue, byte queue_len);
+    char QueueSMS(char *number_str, char *message_str);
+    char FlushSMSBurst(void);
+
+    void InitSMSQueue(void);
+    int QueueSMSEEPROM(char *number_str, char *message_str);
+    byte SMSQueueStatus(int id);
+    byte SMSQueuePending(void);
+    char PollSMSQueue(void);
+
+    char InitDeliveryReports(dlr_slot_t *table, byte num_of_slots);
+    char SendSMSTracked(char *number_str, char *message_str);
+    char TrackSMS(byte mr);
+    char CheckDeliveryReports(void);
+    byte DeliveryStatus(byte mr, unsigned long *latency);
+
+    char InitNewSMSNotification(void);
+    char CheckNewSMS(void);
+    byte NextNewSMS(void);
+
+  //=================================================================
+    // SMS command section: implementaion of methods are placed
+    //                      in the GSM_CMD.cpp  
+    //=================================================================
+    int CMDLibVer(void);
+    byte ParseCmd(char *text, cmd_span_t *tokens, byte max_tokens);
+    char DispatchCmd(const cmd_entry_t *table, byte table_len,
+                     cmd_span_t *tokens, byte num_of_tokens);
+    char DispatchCmdList(const cmd_entry_t *table, byte table_len,
+                         cmd_span_t *tokens, byte num_of_tokens);
+    void InitCmdReply(char *buffer, uint16_t buffer_size);
+    char CmdReply(char *str);
+    char SendCmdReply(char *number_str);
+    char CmdTokenCmp(cmd_span_t *token, const char *str);
+    byte CmdTokenIs(cmd_span_t *token, const char *str);
+
+    //SMS burst statistics - updated by FlushSMSBurst()
+    byte burstSent;
+    unsigned long burstTime;
+
+    //delivery statistics - updated by CheckDeliveryReports()
+    uint16_t dlrDelivered;          // number of delivered SMS
+    unsigned long dlrLatencySum;    // sum of delivery latencies (msec.)
+    unsigned long dlrLatencyMax;    // max. delivery latency (msec.)
+
+    //new SMS notifications - 1 = some notifications were lost
+    byte smsNewLost;
+
+    //number of data blocks passed to the module by BufferData()/FlushData()
+    uint16_t gprsTxFlushes;
+
+    //number of connections opened by KeepSocket()
+    uint16_t gprsConnects;
+
 
   private:
     //=================================================================
@@ -181,5 +303,119 @@ class GSM : public AT
     // last value of speaker volume
     byte last_speaker_volume; 
 
+    //=================================================================
+    // Private section for GPRS
+    //=================================================================
+    byte gprs_mode;                 // GPRS_MODE_...
+    byte gprs_dtr_pin;              // DTR pin or GPRS_NO_DTR
+    byte gprs_dcd_pin;              // DCD pin or GPRS_NO_DCD
+    byte gprs_escaped;              // 1 - data mode was left, socket is opened
+    unsigned long gprs_last_tx;     // time of the last data sent in data mode
+    byte gprs_qsend;                // 1 - quick send mode(AT+CIPQSEND=1)
+    // connection kept by the KeepSocket()
+    byte gprs_keep_type;
+    uint16_t gprs_keep_port;
+    char *gprs_keep_addr;           // NULL - no connection
+    byte gprs_pack_wait;            // AT+CIPCCFG <WaitTm>
+    uint16_t gprs_pack_size;        // AT+CIPCCFG <SendSz>
+    // send buffer - allocated by the user
+    byte *gprs_tx_buf;
+    uint16_t gprs_tx_size;
+    uint16_t gprs_tx_len;           // number of buffered bytes
+    uint16_t gprs_tx_tmout;         // max. delay of the buffered data
+    unsigned long gprs_tx_first;    // time of the oldest buffered byte
+    gprs_match_t gprs_carrier;      // matcher of the NO CARRIER in data mode
+    byte gprs_carrier_seen;         // 1 - NO CARRIER was the last received data
+    // sockets - allocated by the user
+    gprs_socket_t *sock_table;
+    byte sock_num;
+    // receiver of the incoming data and text lines
+    byte sock_rx_state;             // SOCK_RX_...
+    byte sock_rx_link;              // socket of the received frame
+    uint16_t sock_rx_remain;        // bytes of the frame to be received
+    byte sock_line_done;            // 1 - comm_buf contains finished line
+    gprs_sink_t sock_sink;          // sink for incoming data or NULL
+
+    char SendPackCfg(void);
+    uint16_t SegLen(gprs_seg_t *seg);
+    uint16_t SegWrite(gprs_seg_t *seg, uint16_t pos, uint16_t len);
+    void CarrierReset(void);
+    void CarrierRx(byte *data, uint16_t len);
+    byte CarrierLost(void);
+    byte SockRxByte(byte ch);
+    byte SockRx(void);
+    void SockDeliver(void);
+    void SockLine(void);
+    byte SockWait(uint16_t tmout, char const *expected, char const *fail);
+    void SockLock(void);
+    byte SockWindow(byte socket);
+    byte SockQuery(char const *prefix, int link, long *values, byte num_of_values);
+    void SockStatus(char *str, byte socket, char const *status);
+    void SockCmd(const __FlashStringHelper *cmd, byte socket);
+
+    //=================================================================
+    // Private section for SMS PDU
+    //=================================================================
+    byte WaitPrompt(uint16_t start_comm_tmout);
+    byte RcvPDU(char const *header, uint16_t start_comm_tmout, byte **p_pdu, byte *pdu_len);
+    void SendHex(byte *data, byte len);
+    byte PDUEncodeAddress(byte *p, char *number_str);
+    void PDUDecodeAddress(char *number_str, byte toa, byte *p, byte digits);
+
+    //=================================================================
+    // Private section for SMS commands
+    //=================================================================
+    // reply buffer - allocated by the user
+    char *cmd_reply;
+    uint16_t cmd_reply_size;
+    uint16_t cmd_reply_len;
+
+    byte CmdConvertArg(cmd_arg_t *arg, char type, cmd_span_t *token);
+    byte CmdFind(const cmd_entry_t *table, byte table_len,
+                 cmd_span_t *token, cmd_entry_t *entry);
+    char CmdRun(const cmd_entry_t *table, byte table_len,
+                cmd_span_t *tokens, byte num_of_tokens,
+                byte all_tokens, byte *used);
+
+    //=================================================================
+    // Private section for SMS
+    //=================================================================
+    // reassembly table of the concatenated SMS - allocated by the user
+    concat_slot_t *concat_table;
+    byte concat_slots;
+    // reference number of the last sent concatenated SMS
+    byte concat_ref;
+
+    byte ConcatPartLen(byte alphabet, byte *data, uint16_t data_len);
+
+    // outgoing SMS burst queue - allocated by the user
+    sms_out_t *burst_queue;
+    byte burst_queue_len;
+    byte burst_head;  // oldest SMS in the queue
+    byte burst_count; // number of SMS in the queue
+
+    // persistent SMS queue in the EEPROM
+    byte smsq_next_slot;            // slot for the next queued SMS
+    uint16_t smsq_next_seq;         // seq. number for the next queued SMS
+    unsigned long smsq_retry_time;  // time of the last unsuccessful attempt
+    byte smsq_retry_wait;           // 1 - wait before next attempt
+
+    // delivery report tracking table - allocated by the user
+    dlr_slot_t *dlr_table;
+    byte dlr_slots;
+
+    // positions of notified SMS - see NextNewSMS()
+    byte sms_new_pos[SMS_NEW_SLOTS];
+    byte sms_new_count;
+    byte sms_new_notify;  // 1 - new SMS notifications are enabled
+
+    dlr_slot_t *DLRFind(byte mr);
+    char DLRReport(byte mr, byte st);
+    char ReadURC(byte *new_sms);
+    void AddNewSMS(byte position);
+    char SendCNMI(void);
+    byte SMSQueueGetStatus(byte slot);
+    char SendSMSFromEEPROM(int addr);
+
 };
 #endif
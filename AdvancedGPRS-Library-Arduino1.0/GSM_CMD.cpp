@@ -0,0 +1,396 @@
+/*
+	GSM_CMD.cpp - SMS command library for the Advanced GPRS Shield - SiGAlabs
+	www.sigalabs.com
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GSM_CMD.h"
+#include "GSM.h"
+
+extern "C" {
+  #include <string.h>
+}
+
+
+/**********************************************************
+Method returns SMS command library version
+
+return val: 100 means library version 1.00
+            101 means library version 1.01
+**********************************************************/
+int GSM::CMDLibVer(void)
+{
+  return (CMD_LIB_VERSION);
+}
+
+/**********************************************************
+Method compares token with the string case insensitive
+
+return: <0, 0, >0 like strcmp()
+**********************************************************/
+char GSM::CmdTokenCmp(cmd_span_t *token, const char *str)
+{
+  byte i;
+  char ch;
+
+  for (i = 0; i < token->len; i++) {
+    ch = token->str[i];
+    if (ch >= 'a' && ch <= 'z') ch -= 'a' - 'A';
+    if (str[i] == 0x00) return (1);       // token is longer
+    if (ch != str[i]) return (ch < str[i] ? -1 : 1);
+  }
+  return (str[i] == 0x00 ? 0 : -1);     // str is longer
+}
+
+/**********************************************************
+Method checks if the token is the same as the string
+(case sensitive - e.g. for the password)
+
+return: 1 - the same
+        0 - different
+**********************************************************/
+byte GSM::CmdTokenIs(cmd_span_t *token, const char *str)
+{
+  return (strlen(str) == token->len && strncmp(token->str, str, token->len) == 0);
+}
+
+/**********************************************************
+Method splits the SMS text to tokens separated by spaces,
+tabs or line ends. Text is parsed only once and it is not
+copied or changed, tokens point directly to the text.
+
+text:         SMS text finished by 0x00
+tokens:       array for the tokens
+max_tokens:   size of the array, other tokens are ignored
+
+return: number of tokens
+
+
+an example of usage:
+        cmd_span_t tokens[CMD_MAX_TOKENS];
+        byte num_of_tokens;
+
+        num_of_tokens = gsm.ParseCmd(sms_text, tokens, CMD_MAX_TOKENS);
+**********************************************************/
+byte GSM::ParseCmd(char *text, cmd_span_t *tokens, byte max_tokens)
+{
+  byte num_of_tokens = 0;
+
+  while (*text && num_of_tokens < max_tokens) {
+    // skip separators
+    while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+    if (*text == 0x00) break;
+
+    tokens[num_of_tokens].str = text;
+    while (*text && *text != ' ' && *text != '\t' && *text != '\r' && *text != '\n') text++;
+    tokens[num_of_tokens].len = text - tokens[num_of_tokens].str;
+    num_of_tokens++;
+  }
+  return (num_of_tokens);
+}
+
+/**********************************************************
+Method converts token to the argument of the given type
+
+return: 1 - argument is valid
+        0 - token doesn't correspond to the type
+**********************************************************/
+byte GSM::CmdConvertArg(cmd_arg_t *arg, char type, cmd_span_t *token)
+{
+  byte i = 0;
+  byte negative = 0;
+
+  arg->type = type;
+  arg->span = *token;
+  arg->val = 0;
+
+  switch (type) {
+    case CMD_ARG_INT:
+      if (token->str[0] == '-' || token->str[0] == '+') {
+        negative = (token->str[0] == '-');
+        i++;
+      }
+      if (i == token->len) return (0);
+      for (; i < token->len; i++) {
+        if (token->str[i] < '0' || token->str[i] > '9') return (0);
+        arg->val = arg->val * 10 + (token->str[i] - '0');
+      }
+      if (negative) arg->val = -arg->val;
+      return (1);
+
+    case CMD_ARG_BOOL:
+      if (CmdTokenCmp(token, "ON") == 0 || CmdTokenCmp(token, "1") == 0
+          || CmdTokenCmp(token, "YES") == 0) {
+        arg->val = 1;
+        return (1);
+      }
+      if (CmdTokenCmp(token, "OFF") == 0 || CmdTokenCmp(token, "0") == 0
+          || CmdTokenCmp(token, "NO") == 0) {
+        return (1);
+      }
+      return (0);
+  }
+  // CMD_ARG_STR
+  return (1);
+}
+
+/**********************************************************
+Method finds the command in the table by the binary search
+
+return: 1 - command was found and copied to the entry
+        0 - command is not in the table
+**********************************************************/
+byte GSM::CmdFind(const cmd_entry_t *table, byte table_len,
+                  cmd_span_t *token, cmd_entry_t *entry)
+{
+  byte low = 0;
+  byte high = table_len;
+  byte middle;
+  char cmp;
+
+  while (low < high) {
+    middle = (low + high) / 2;
+    memcpy_P(entry, &table[middle], sizeof(cmd_entry_t));
+    cmp = CmdTokenCmp(token, entry->name);
+    if (cmp == 0) return (1);
+    if (cmp < 0) high = middle;
+    else low = middle + 1;
+  }
+  return (0);
+}
+
+/**********************************************************
+Method runs one command - the first token
+If all_tokens is 1 all next tokens are arguments, otherwise
+optional arguments are taken only while they correspond to
+the type and they are not command names, so next command
+can follow.
+
+used: number of tokens used by the command (incl. its name)
+**********************************************************/
+char GSM::CmdRun(const cmd_entry_t *table, byte table_len,
+                 cmd_span_t *tokens, byte num_of_tokens,
+                 byte all_tokens, byte *used)
+{
+  cmd_entry_t entry;
+  cmd_entry_t next;
+  cmd_arg_t argv[CMD_MAX_ARGS];
+  byte argc;
+  byte max_args;
+
+  *used = 0;
+  if (num_of_tokens == 0) return (CMD_ERR_NO_CMD);
+  if (!CmdFind(table, table_len, &tokens[0], &entry)) return (CMD_ERR_UNKNOWN);
+
+  max_args = strlen(entry.arg_types);
+  if (all_tokens && num_of_tokens - 1 > max_args) return (CMD_ERR_ARG);
+
+  // check and convert arguments
+  for (argc = 0; argc < max_args && argc + 1 < num_of_tokens; argc++) {
+    if (argc >= entry.min_args && !all_tokens) {
+      // optional argument - it can be the next command
+      if (CmdFind(table, table_len, &tokens[argc + 1], &next)) break;
+      if (!CmdConvertArg(&argv[argc], entry.arg_types[argc], &tokens[argc + 1])) break;
+    }
+    else if (!CmdConvertArg(&argv[argc], entry.arg_types[argc], &tokens[argc + 1])) {
+      return (CMD_ERR_ARG);
+    }
+  }
+  if (argc < entry.min_args) return (CMD_ERR_ARG);
+
+  *used = argc + 1;
+  return (entry.handler(argc, argv));
+}
+
+/**********************************************************
+Method finds the command in the table and calls its handler
+The first token is the command name, next tokens are its
+arguments. Table is searched by the binary search so it
+must be sorted by the names(see cmd_entry_t), arguments
+are checked and converted before the handler is called.
+
+table:          command table placed in the flash(PROGMEM)
+table_len:      number of items in the table
+tokens:         tokens from the ParseCmd()
+num_of_tokens:  number of tokens
+
+return:
+        ERROR ret. val:
+        ---------------
+        CMD_ERR_NO_CMD  - there is no token
+        CMD_ERR_UNKNOWN - command was not found
+        CMD_ERR_ARG     - wrong number or type of arguments
+
+        OK ret val:
+        -----------
+        value returned by the handler
+
+
+an example of usage:
+        char CmdOut1(byte argc, cmd_arg_t *argv)
+        {
+          digitalWrite(OUT1, argv[0].val ? HIGH : LOW);
+          return (0);
+        }
+
+        const cmd_entry_t commands[] PROGMEM = {
+          {"ANALOG", "",  0, CmdAnalog},
+          {"OUT1",   "b", 1, CmdOut1}
+        };
+
+        num_of_tokens = gsm.ParseCmd(sms_text, tokens, CMD_MAX_TOKENS);
+        gsm.DispatchCmd(commands, 2, tokens, num_of_tokens);
+**********************************************************/
+char GSM::DispatchCmd(const cmd_entry_t *table, byte table_len,
+                      cmd_span_t *tokens, byte num_of_tokens)
+{
+  byte used;
+
+  return (CmdRun(table, table_len, tokens, num_of_tokens, 1, &used));
+}
+
+/**********************************************************
+Method runs several commands from one SMS one by one
+(e.g. "ANALOG INPUTS OUT1 ON OUTPUTS")
+Every command takes its mandatory arguments, optional
+arguments are taken only if they are not command names.
+Handlers can collect their results by the CmdReply() so
+only one SMS is sent back for all commands.
+
+table:          command table placed in the flash(PROGMEM)
+table_len:      number of items in the table
+tokens:         tokens from the ParseCmd()
+num_of_tokens:  number of tokens
+
+return:
+        ERROR ret. val:
+        ---------------
+        CMD_ERR_NO_CMD  - there is no token
+        CMD_ERR_UNKNOWN - command was not found
+        CMD_ERR_ARG     - wrong number or type of arguments
+        (commands before the wrong one were executed)
+
+        OK ret val:
+        -----------
+        number of executed commands
+
+
+an example of usage:
+        num_of_tokens = gsm.ParseCmd(sms_text, tokens, CMD_MAX_TOKENS);
+        if (gsm.DispatchCmdList(commands, 5, tokens, num_of_tokens) < 0) {
+          gsm.CmdReply("ERROR");
+        }
+        gsm.SendCmdReply(phone_num);
+**********************************************************/
+char GSM::DispatchCmdList(const cmd_entry_t *table, byte table_len,
+                          cmd_span_t *tokens, byte num_of_tokens)
+{
+  char ret_val;
+  char num_of_cmds = 0;
+  byte used;
+
+  if (num_of_tokens == 0) return (CMD_ERR_NO_CMD);
+
+  while (num_of_tokens) {
+    ret_val = CmdRun(table, table_len, tokens, num_of_tokens, 0, &used);
+    if (ret_val < 0) return (ret_val);
+    num_of_cmds++;
+    tokens += used;
+    num_of_tokens -= used;
+  }
+  return (num_of_cmds);
+}
+
+/**********************************************************
+Method initializes the reply buffer
+Buffer is allocated by the user, results of all commands
+from one SMS are collected there by CmdReply() and sent
+by SendCmdReply() as one SMS (or concatenated SMS if they
+don't fit to one SMS).
+
+buffer:       pointer to the buffer
+buffer_size:  size of the buffer incl. finishing 0x00
+
+
+an example of usage:
+        GSM gsm;
+        char reply[300];
+
+        gsm.InitCmdReply(reply, sizeof(reply));
+**********************************************************/
+void GSM::InitCmdReply(char *buffer, uint16_t buffer_size)
+{
+  cmd_reply = buffer;
+  cmd_reply_size = buffer_size;
+  cmd_reply_len = 0;
+  if (buffer_size) buffer[0] = 0x00;
+}
+
+/**********************************************************
+Method appends the string to the reply buffer
+Results are separated by the space.
+
+str:  string to append
+
+return: 1 - string was appended
+        0 - there is no reply buffer or the string doesn't fit
+            (the reply is not changed)
+**********************************************************/
+char GSM::CmdReply(char *str)
+{
+  uint16_t len = strlen(str);
+  byte sep = (cmd_reply_len != 0);
+
+  if (cmd_reply == NULL) return (0);
+  if (cmd_reply_len + sep + len >= cmd_reply_size) return (0);
+
+  if (sep) cmd_reply[cmd_reply_len++] = ' ';
+  strcpy(cmd_reply + cmd_reply_len, str);
+  cmd_reply_len += len;
+  return (1);
+}
+
+/**********************************************************
+Method sends collected reply and clears the reply buffer
+Reply which doesn't fit to one SMS is sent as concatenated
+SMS by the SendLongSMS().
+
+number_str:   pointer to the phone number string
+
+return: the same as SendLongSMS()
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -3 - reply needs more then 255 parts
+
+        OK ret val:
+        -----------
+        0 - reply is empty(nothing was sent) or SMS was not sent
+            (some part was not sent)
+        1 - SMS was sent(all parts)
+**********************************************************/
+char GSM::SendCmdReply(char *number_str)
+{
+  char ret_val;
+
+  if (cmd_reply == NULL || cmd_reply_len == 0) return (0);
+
+  ret_val = SendLongSMS(number_str, cmd_reply);
+  // reply is cleared also in case of error so it is not mixed
+  // with the reply for the next SMS
+  cmd_reply_len = 0;
+  cmd_reply[0] = 0x00;
+  return (ret_val);
+}
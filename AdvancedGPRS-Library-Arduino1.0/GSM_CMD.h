@@ -0,0 +1,105 @@
+/*
+	GSM_CMD.h - SMS command library for the Advanced GPRS Shield - SiGAlabs
+	www.sigalabs.com
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __GSM_CMD
+#define __GSM_CMD
+
+#if defined(ARDUINO) && ARDUINO >= 100
+  #include "Arduino.h"
+  #else
+  #include "WProgram.h"
+#endif
+
+
+#define CMD_LIB_VERSION 101 // library version X.YY (e.g. 1.00)
+/*
+    Version
+    --------------------------------------------------------------------------
+    100       Initial version
+              SMS text is split to tokens once, commands are found
+              in the sorted table by binary search, arguments are
+              converted according to the table
+    --------------------------------------------------------------------------
+    101       Several commands in one SMS - DispatchCmdList(), results
+              are collected to one reply buffer and sent as one
+              (or concatenated) SMS
+    --------------------------------------------------------------------------
+*/
+
+// max. number of tokens in one SMS
+#ifndef CMD_MAX_TOKENS
+	#define CMD_MAX_TOKENS        8
+#endif // end of ifndef CMD_MAX_TOKENS
+
+// max. number of arguments of one command
+#ifndef CMD_MAX_ARGS
+	#define CMD_MAX_ARGS          4
+#endif // end of ifndef CMD_MAX_ARGS
+
+// max. length of the command name
+#ifndef CMD_NAME_LEN
+	#define CMD_NAME_LEN          8
+#endif // end of ifndef CMD_NAME_LEN
+
+// argument types used in the cmd_entry_t.arg_types string
+#define CMD_ARG_INT           'i'   // integer number, value in val
+#define CMD_ARG_BOOL          'b'   // ON/OFF, 1/0, YES/NO - value 1/0 in val
+#define CMD_ARG_STR           's'   // any string, only span is valid
+
+// return values of the DispatchCmd() method
+// handlers should return values >= 0
+enum cmd_ret_val_enum
+{
+  CMD_ERR_ARG = -3,       // wrong number or type of arguments
+  CMD_ERR_UNKNOWN = -2,   // command was not found in the table
+  CMD_ERR_NO_CMD = -1,    // there is no token
+
+  CMD_LAST_ITEM
+};
+
+// one token of the SMS text - it points directly to the SMS text
+// so the text is not copied and it is not changed
+typedef struct
+{
+  char *str;      // first character of the token
+  byte len;       // number of characters
+} cmd_span_t;
+
+// converted argument of the command
+typedef struct
+{
+  char type;        // CMD_ARG_...
+  long val;         // value of the CMD_ARG_INT and CMD_ARG_BOOL
+  cmd_span_t span;  // original token
+} cmd_arg_t;
+
+// command handler
+typedef char (*cmd_handler_t)(byte argc, cmd_arg_t *argv);
+
+// one item of the command table
+// table is placed in the flash(PROGMEM) and it must be sorted
+// by the name - names are compared case insensitive (upper case)
+typedef struct
+{
+  char name[CMD_NAME_LEN+1];          // command name in upper case
+  char arg_types[CMD_MAX_ARGS+1];     // CMD_ARG_... for every argument
+  byte min_args;                      // number of mandatory arguments
+  cmd_handler_t handler;
+} cmd_entry_t;
+
+
+#endif
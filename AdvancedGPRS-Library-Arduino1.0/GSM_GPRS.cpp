@@ -64,19 +64,71 @@ an example of usage:
         gsm.InitGPRS("internet", "", ""); 
 **********************************************************/
 char GSM::InitGPRS(char* apn, char* login, char* password)
+{
+  return (InitGPRS(apn, login, password, GPRS_MODE_TRANSPARENT));
+}
+
+/**********************************************************
+Method initializes GPRS in the required mode
+- the same as InitGPRS() above but the mode can be selected
+
+mode:     GPRS_MODE_TRANSPARENT - one socket opened by the OpenSocket(),
+                                  comm. line is in the DATA state
+          GPRS_MODE_SINGLE      - one socket opened by the SocketOpen(),
+                                  data are sent by AT+CIPSEND=<len>,
+                                  comm. line stays free for other AT
+                                  commands(SMS, signal level etc.)
+          GPRS_MODE_MULTI       - up to SOCK_MAX_LINKS sockets opened by
+                                  the SocketOpen(), comm. line stays free
+                                  for other AT commands(SMS etc.)
+
+In the GPRS_MODE_SINGLE and GPRS_MODE_MULTI the manual receive
+mode(AT+CIPRXGET=1) is enabled: incoming data stay in the module
+and they are read only by the PollSockets(), so other AT commands
+(SendSMS(), CheckRegistration() etc.) can be used between socket
+methods and they never receive the data. Notifications which came
+during other AT commands can be lost, therefore the PollSockets()
+reads all connected sockets after every other AT command.
+Don't disable the manual mode(SetSocketFlowControl(0)) if other
+AT commands are used during the session.
+
+an example of usage:
+        GSM gsm;
+        gprs_socket_t sockets[3];
+
+        gsm.InitSockets(sockets, 3);
+        gsm.InitGPRS("internet", "", "", GPRS_MODE_MULTI);
+**********************************************************/
+char GSM::InitGPRS(char* apn, char* login, char* password, byte mode)
 {
   char ret_val = -1;
   char cmd[150];
+  byte i;
 
   if (CLS_FREE != GetCommLineStatus()) return (ret_val);
   SetCommLineStatus(CLS_ATCMD);
     ret_val = SendATCmdWaitResp("AT+CIPSHUT", 2000, 1000, "SHUT OK", 3);
     if (ret_val == AT_RESP_OK) {
-	  //Set Single IP Connection
-	  ret_val = SendATCmdWaitResp("AT+CIPMUX=0", 1000, 1000, "OK", 3);
+      // all connections were closed
+      gprs_mode = mode;
+      gprs_escaped = 0;
+      for (i = 0; i < sock_num; i++) sock_table[i].state = SOCK_FREE;
+      sock_rx_state = SOCK_RX_LINE;
+	  //Set Single or Multi IP Connection
+	  ret_val = SendATCmdWaitResp(mode == GPRS_MODE_MULTI ? "AT+CIPMUX=1" : "AT+CIPMUX=0",
+	                              1000, 1000, "OK", 3);
 		if (ret_val == AT_RESP_OK) {
-				// Set transparent mode
-				ret_val = SendATCmdWaitResp("AT+CIPMODE=1", 1000, 2000, "OK", 3);
+				// Set transparent or non-transparent mode
+				ret_val = SendATCmdWaitResp(mode == GPRS_MODE_TRANSPARENT ? "AT+CIPMODE=1" : "AT+CIPMODE=0",
+				                            1000, 2000, "OK", 3);
+				if (ret_val == AT_RESP_OK && mode == GPRS_MODE_SINGLE) {
+					// incoming data are framed: +IPD,<len>:<data>
+					ret_val = SendATCmdWaitResp("AT+CIPHEAD=1", 1000, 1000, "OK", 3);
+				}
+				if (ret_val == AT_RESP_OK && mode != GPRS_MODE_TRANSPARENT) {
+					// manual receive mode - data never come during other AT commands
+					ret_val = SendATCmdWaitResp("AT+CIPRXGET=1", 1000, 1000, "OK", 3);
+				}
 				if (ret_val == AT_RESP_OK) {
 					//prepare AT+CSTT command: AT+CSTT="apn","user","pass"
 					strcpy(cmd, "AT+CSTT=\"");
@@ -215,6 +267,8 @@ char GSM::DisableGPRS(void)
   ret_val = SendATCmdWaitResp("AT+CIPSHUT", 2000, 1000, "SHUT OK", 2);
   if (ret_val == AT_RESP_OK) {
     // context was disabled
+    gprs_escaped = 0;
+    gprs_keep_addr = NULL;
     ret_val = 1;
   }
   else ret_val = 0; // context was not disabled
@@ -261,6 +315,8 @@ char GSM::OpenSocket(byte socket_type, uint16_t remote_port, char* remote_addr)
 
   if (CLS_FREE != GetCommLineStatus()) return (ret_val);
   SetCommLineStatus(CLS_ATCMD);
+  // KeepSocket() remembers the connection after this call
+  gprs_keep_addr = NULL;
   // prepare command:  AT+CIPSTART="TCP","www.google.com","port"
   strcpy(cmd, "AT+CIPSTART=\"");
   // add socket type
@@ -283,6 +339,9 @@ char GSM::OpenSocket(byte socket_type, uint16_t remote_port, char* remote_addr)
   ret_val = SendATCmdWaitResp(cmd, 20000, 3000, "CONNECT\r\n", 3);
   if (ret_val == AT_RESP_OK) {
     ret_val = 1;
+    CarrierReset();
+    // data of the previous connection are not sent
+    gprs_tx_len = 0;
     SetCommLineStatus(CLS_DATA);
   }
   else {
@@ -296,9 +355,12 @@ char GSM::OpenSocket(byte socket_type, uint16_t remote_port, char* remote_addr)
 
 /**********************************************************
 Methods send data to the serial port
-There are 2 modification with possibility to send:
+There are 3 modification with possibility to send:
 - string (finished by the standard end character 0x00)
 - certain size of binary data buffer
+- list of segments from the RAM or the flash(PROGMEM),
+  segments are sent in the order, no assembly buffer
+  is necessary
 
 
 return: 
@@ -313,16 +375,34 @@ an example of usage:
         gsm.SendData("Some text"); 
         or
         gsm.SendData(buffer, 20); 
+        or
+        const char get[] PROGMEM = "GET / HTTP/1.1\r\nHost: ";
+        const char end[] PROGMEM = "\r\n\r\n";
+        gprs_seg_t request[] = {{get, 0, GPRS_SEG_PGM},
+                                {host, 0, GPRS_SEG_RAM},
+                                {end, 0, GPRS_SEG_PGM}};
+
+        gsm.SendData(request, 3);
 
 **********************************************************/
 void GSM::SendData(char* str_data)
 {
   Serial.print(str_data);
+  gprs_last_tx = millis();
 }
 
 void GSM::SendData(byte* data_buffer, unsigned short size)
 {
   Serial.write(data_buffer, size);
+  gprs_last_tx = millis();
+}
+
+void GSM::SendData(gprs_seg_t *segs, byte num_of_segs)
+{
+  byte seg;
+
+  for (seg = 0; seg < num_of_segs; seg++) SegWrite(&segs[seg], 0, SegLen(&segs[seg]));
+  gprs_last_tx = millis();
 }
 
 /**********************************************************
@@ -347,6 +427,8 @@ uint16_t  GSM::RcvData(uint16_t start_comm_tmout, uint16_t max_interchar_tmout,
 {
   byte status;
 
+  // buffered request must be sent before waiting for the reply
+  FlushData();
   RxInit(start_comm_tmout, max_interchar_tmout, 0, 0); 
   // wait until response is not finished
 
@@ -359,19 +441,219 @@ uint16_t  GSM::RcvData(uint16_t start_comm_tmout, uint16_t max_interchar_tmout,
 
   // check <CR><LF>NO CARRIER<CR><LF>
   // in case this string was received => socked is closed
-  if (comm_buf_len) { 
-    if (StrInBin(comm_buf, "\r\nNO CARRIER\r\n", comm_buf_len) != -1) {
-      // NO CARRIER was received => socket was closed from the host side
-      // we can set the communication line to the FREE state
-      SetCommLineStatus(CLS_FREE);
-    }
-  }
+  // (string can be split to several calls of RcvData())
+  CarrierRx(comm_buf, comm_buf_len);
+  CarrierLost();
 
   return (comm_buf_len);
 }
 
+/**********************************************************
+Method configures fast escape from the transparent data mode
+
+If the DTR pin of the GSM module is connected to the Arduino,
+data mode is left by the DTR pulse(AT&D1) which takes only
+some msec. Otherwise the escape sequence "+++" is used, but
+only remaining part of the guard time(GPRS_ESC_GUARD_TIME
+from the last sent data) is waited.
+Escape sequence is enabled by AT+CIPCCFG as well.
+
+dtr_pin:  Arduino pin connected to the DTR of the module
+          GPRS_NO_DTR - DTR is not connected
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0 - configuration was not accepted
+        1 - fast escape is configured
+
+
+an example of usage:
+        gsm.InitGPRS("internet", "", "");
+        gsm.InitFastEscape(GPRS_NO_DTR);
+**********************************************************/
+char GSM::InitFastEscape(byte dtr_pin)
+{
+  char ret_val = -1;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+
+  gprs_dtr_pin = dtr_pin;
+  ret_val = SendPackCfg();
+  if (ret_val == AT_RESP_OK && dtr_pin != GPRS_NO_DTR) {
+    // DTR ON->OFF: switch to the command mode, connection is kept
+    pinMode(dtr_pin, OUTPUT);
+    digitalWrite(dtr_pin, LOW);
+    ret_val = SendATCmdWaitResp("AT&D1", 1000, 100, "OK", 2);
+  }
+  if (ret_val == AT_RESP_OK) ret_val = 1;
+  else {
+    gprs_dtr_pin = GPRS_NO_DTR;
+    ret_val = 0;
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method configures the detection of the carrier by the DCD pin
+
+If the DCD pin of the GSM module is connected to the Arduino,
+DCD follows the state of the connection(AT&C1) and the end
+of the transparent data mode is detected by the pin - it can't
+be faked by the payload and there is no waiting. Otherwise
+NO CARRIER text is used - see CarrierLost().
+
+dcd_pin:  Arduino pin connected to the DCD of the module
+          GPRS_NO_DCD - DCD is not connected
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0 - configuration was not accepted
+        1 - carrier detection is configured
+
+
+an example of usage:
+        gsm.InitGPRS("internet", "", "");
+        gsm.InitCarrierDetect(8);
+**********************************************************/
+char GSM::InitCarrierDetect(byte dcd_pin)
+{
+  char ret_val = -1;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+
+  gprs_dcd_pin = GPRS_NO_DCD;
+  if (dcd_pin == GPRS_NO_DCD) {
+    // DCD always ON
+    ret_val = SendATCmdWaitResp("AT&C0", 1000, 100, "OK", 2);
+  }
+  else {
+    pinMode(dcd_pin, INPUT);
+    ret_val = SendATCmdWaitResp("AT&C1", 1000, 100, "OK", 2);
+    if (ret_val == AT_RESP_OK) gprs_dcd_pin = dcd_pin;
+  }
+  if (ret_val == AT_RESP_OK) ret_val = 1;
+  else ret_val = 0;
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method switches the transparent data mode to the command mode,
+the socket stays opened so other AT commands(SMS etc.) can
+be used and data mode can be restored by the ReturnToDataMode()
+
+Data mode is left by the DTR pulse or by "+++" after the
+guard time - see InitFastEscape(). There is no repeating,
+the result is known after max. 2 x GPRS_ESC_GUARD_TIME.
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not in the data(GPRS) state
+
+        OK ret val:
+        -----------
+        0 - module didn't leave data mode
+        1 - module is in the command mode, comm. line is free
+
+
+an example of usage:
+        if (gsm.LeaveDataMode() == 1) {
+          gsm.CheckRegistration();
+          gsm.ReturnToDataMode();
+        }
+**********************************************************/
+char GSM::LeaveDataMode(void)
+{
+  char ret_val = -1;
+  unsigned long guard;
+
+  if (CLS_DATA != GetCommLineStatus()) return (ret_val);
+
+  // nothing from the data mode is expected any more
+  FlushData();
+  outSerial.flush();
+  if (gprs_dtr_pin != GPRS_NO_DTR) {
+    // DTR pulse
+    digitalWrite(gprs_dtr_pin, HIGH);
+    ret_val = WaitResp(GPRS_ESC_DTR_TMOUT, 20, "OK");
+    digitalWrite(gprs_dtr_pin, LOW);
+  }
+  else {
+    // wait only remaining part of the guard time before "+++"
+    guard = millis() - gprs_last_tx;
+    if (guard < GPRS_ESC_GUARD_TIME) delay(GPRS_ESC_GUARD_TIME - guard);
+    outSerial.print(F("+++"));
+    gprs_last_tx = millis();
+    // module answers OK after the guard time behind "+++"
+    ret_val = WaitResp(GPRS_ESC_GUARD_TIME + 500, 20, "OK");
+  }
+
+  if (ret_val == RX_FINISHED_STR_RECV) {
+    gprs_escaped = 1;
+    SetCommLineStatus(CLS_FREE);
+    ret_val = 1;
+  }
+  else ret_val = 0;
+  return (ret_val);
+}
+
+/**********************************************************
+Method returns back to the transparent data mode after
+the LeaveDataMode() (ATO)
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free or data mode was not left
+
+        OK ret val:
+        -----------
+        0 - connection is not restored(socket was closed)
+        1 - module is in the data mode again
+**********************************************************/
+char GSM::ReturnToDataMode(void)
+{
+  char ret_val = -1;
+
+  if (CLS_FREE != GetCommLineStatus() || !gprs_escaped) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+
+  ret_val = SendATCmdWaitResp("ATO", 2000, 100, "CONNECT", 1);
+  if (ret_val == AT_RESP_OK) {
+    gprs_escaped = 0;
+    CarrierReset();
+    SetCommLineStatus(CLS_DATA);
+    ret_val = 1;
+  }
+  else {
+    // socket is not opened any more
+    gprs_escaped = 0;
+    SetCommLineStatus(CLS_FREE);
+    ret_val = 0;
+  }
+  return (ret_val);
+}
+
 /**********************************************************
 Method closes previously opened socket
+Data mode is left by the LeaveDataMode() and the socket
+is closed by the quick close(AT+CIPCLOSE=1).
 
 return: 
         ERROR ret. val:
@@ -392,55 +674,56 @@ an example of usage:
 char GSM::CloseSocket(void)
 {
   char ret_val = -1;
-  byte i;
-  byte* rx_data;
 
-  if (CLS_FREE == GetCommLineStatus()) {
+  // connection can't be reused by KeepSocket() anymore
+  gprs_keep_addr = NULL;
+  if (CLS_FREE == GetCommLineStatus() && !gprs_escaped) {
     ret_val = 1; // socket was already closed
     return (ret_val);
   }
 
-  // we are in the DATA state so try to close the socket
+  // we are in the DATA state so leave it first
   // ---------------------------------------------------
-  for (i = 0; i < 3; i++) {
-    // make dalay 500msec. before escape seq. "+++"
-    RcvData(1500, 100, &rx_data); // trick - function is used for generation a delay
-    // send escape sequence +++ and wait for "NO CARRIER"
-    SendData("+++");
-    if (RX_FINISHED_STR_RECV == WaitResp(5000, 1000, "OK")) {
-      SetCommLineStatus(CLS_ATCMD);
-      ret_val = SendATCmdWaitResp("AT+CIPCLOSE", 5000, 1000, "CLOSE OK", 2);
-	  if (ret_val == AT_RESP_OK) {
-       // socket was successfully closed
-         ret_val = 1;
-      }
-	  else ret_val = 0; // socket was not successfully closed
-      SetCommLineStatus(CLS_FREE);
-      break;
-    }
-    else {
+  if (CLS_DATA == GetCommLineStatus()) {
+    if (LeaveDataMode() != 1) {
       // try common AT command just to be sure that the socket
       // has not been already closed
-      ret_val = SendATCmdWaitResp("AT", 1000, 1000, "OK", 2);
-	  if (ret_val == AT_RESP_OK) {
-       // socket was successfully closed ret_val = 1;
+      SetCommLineStatus(CLS_ATCMD);
+      ret_val = SendATCmdWaitResp("AT", 500, 50, "OK", 1);
+      if (ret_val == AT_RESP_OK) {
         SetCommLineStatus(CLS_FREE);
-        break;
+        ret_val = 1; // socket was already closed
       }
       else {
+        SetCommLineStatus(CLS_DATA);
         ret_val = 0;
       }
+      return (ret_val);
     }
   }
 
+  if (CLS_FREE != GetCommLineStatus()) return (-1);
+  SetCommLineStatus(CLS_ATCMD);
+  gprs_escaped = 0;
+  ret_val = SendATCmdWaitResp("AT+CIPCLOSE=1", 5000, 100, "CLOSE OK", 1);
+  if (ret_val == AT_RESP_OK) {
+    // socket was successfully closed
+    ret_val = 1;
+  }
+  else ret_val = 0; // socket was not successfully closed
+  SetCommLineStatus(CLS_FREE);
+
   return (ret_val);
 }
 
 /**********************************************************
 Method used for finding string in the binary data buffer
 
+Every character of the buffer is checked only once(see MatchInit()).
+
 p_bin_data: pointer to the binary "buffer" where a string should be find
-p_string_to_search: pointer to the string which is supposed to be find
+p_string_to_search: pointer to the string which is supposed to be find,
+                    max. GPRS_MATCH_MAX_LEN characters
 size: size of the binary "buffer"
 
 return: 
@@ -449,26 +732,1610 @@ return:
 **********************************************************/
 signed short GSM::StrInBin(byte* p_bin_data, char* p_string_to_search, unsigned short size)
 {
-  uint16_t pos_1, pos_2, pos_before_match;
-
-  pos_1 = 0;
-  pos_2 = 0;
-  pos_before_match = 0;
-  if (size) {
-    while (pos_1 < size) {
-      if (p_string_to_search[pos_2] == p_bin_data[pos_1]) {
-        pos_2++;
-        pos_1++;
-        if (p_string_to_search[pos_2] == 0) return (pos_before_match);
+  gprs_match_t match;
+  int end;
+
+  MatchInit(&match, p_string_to_search);
+  end = MatchData(&match, p_bin_data, size);
+  if (end == -1) return (-1);
+  return (end - match.len);
+}
+
+
+/**********************************************************
+Method initializes the socket table for GPRS_MODE_MULTI
+and GPRS_MODE_SINGLE
+
+Table is allocated by the user, index of the socket in the
+table is the connection number of the GSM module so max.
+SOCK_MAX_LINKS sockets can be used(only the first one
+in the GPRS_MODE_SINGLE). Every socket has its
+own receive buffer(SOCK_RX_BUF_LEN).
+
+table:          pointer to the table
+num_of_sockets: number of items in the table
+
+
+an example of usage:
+        GSM gsm;
+        gprs_socket_t sockets[3];
+
+        gsm.InitSockets(sockets, 3);
+**********************************************************/
+void GSM::InitSockets(gprs_socket_t *table, byte num_of_sockets)
+{
+  byte i;
+
+  if (num_of_sockets > SOCK_MAX_LINKS) num_of_sockets = SOCK_MAX_LINKS;
+  sock_table = table;
+  sock_num = num_of_sockets;
+  for (i = 0; i < sock_num; i++) {
+    sock_table[i].state = SOCK_FREE;
+    sock_table[i].flags = 0;
+    sock_table[i].rx_len = 0;
+    sock_table[i].rx_lost = 0;
+  }
+  sock_rx_state = SOCK_RX_LINE;
+  sock_line_done = 0;
+}
+
+/**********************************************************
+Method processes one character received from the GSM module
+in the GPRS_MODE_MULTI and GPRS_MODE_SINGLE
+- data of the +RECEIVE,<n>,<len>: frame are placed to the
+  receive buffer of the socket <n>
+- data of the +IPD,<len>: frame are placed to the receive
+  buffer of the socket 0
+- other characters are collected as text line in the comm_buf
+
+return: 1 - text line is finished in the comm_buf
+        0 - line is not finished yet
+**********************************************************/
+byte GSM::SockRxByte(byte ch)
+{
+  char *p_char;
+  gprs_socket_t *sock;
+
+  if (sock_rx_state == SOCK_RX_DATA) {
+    if (sock_sink != NULL && (sock_rx_link >= sock_num
+                              || !(sock_table[sock_rx_link].flags & SOCK_FLAG_RX_PAUSED))) {
+      // data are collected in the comm_buf and passed to the sink
+      comm_buf[comm_buf_len++] = ch;
+      if (comm_buf_len == COMM_BUF_LEN || sock_rx_remain == 1) SockDeliver();
+    }
+    else if (sock_rx_link < sock_num) {
+      // rest of the frame of the paused socket is kept for SocketResume()
+      sock = &sock_table[sock_rx_link];
+      if (sock->rx_len < SOCK_RX_BUF_LEN) sock->rx_buf[sock->rx_len++] = ch;
+      else sock->rx_lost++;
+    }
+    if (--sock_rx_remain == 0) sock_rx_state = SOCK_RX_LINE;
+    return (0);
+  }
+
+  if (sock_line_done) {
+    // previous line was already processed
+    sock_line_done = 0;
+    comm_buf_len = 0;
+  }
+
+  if (ch == '\n') {
+    if (comm_buf_len && comm_buf[comm_buf_len - 1] == '\r') comm_buf_len--;
+    comm_buf[comm_buf_len] = 0x00;
+    if (comm_buf_len == 0) return (0); // empty line
+
+    // header of the incoming data: +RECEIVE,<n>,<len>:
+    if (strncmp((char *)comm_buf, "+RECEIVE,", 9) == 0
+        && comm_buf[comm_buf_len - 1] == ':') {
+      p_char = (char *)comm_buf + 9;
+      sock_rx_link = atoi(p_char);
+      p_char = strchr(p_char, ',');
+      if (p_char != NULL) {
+        sock_rx_remain = atoi(p_char + 1);
+        if (sock_rx_remain) sock_rx_state = SOCK_RX_DATA;
       }
-      else {
-        pos_2 = 0; // from the start of p_string_to_search
-        pos_before_match++;
-        pos_1 = pos_before_match;
+      comm_buf_len = 0;
+      return (0);
+    }
+    // data fetched in the manual mode: +CIPRXGET: 2,[<n>,]<len>,<not read len>
+    if (strncmp((char *)comm_buf, "+CIPRXGET: 2,", 13) == 0) {
+      p_char = (char *)comm_buf + 13;
+      sock_rx_link = 0;
+      if (gprs_mode == GPRS_MODE_MULTI) {
+        sock_rx_link = atoi(p_char);
+        p_char = strchr(p_char, ',');
       }
+      if (p_char != NULL) {
+        if (gprs_mode == GPRS_MODE_MULTI) p_char++;
+        sock_rx_remain = atoi(p_char);
+        if (sock_rx_remain) sock_rx_state = SOCK_RX_DATA;
+        // all data were read from the module
+        p_char = strchr(p_char, ',');
+        if (p_char != NULL && atoi(p_char + 1) == 0 && sock_rx_link < sock_num) {
+          sock_table[sock_rx_link].flags &= ~SOCK_FLAG_RX_PENDING;
+        }
+      }
+      comm_buf_len = 0;
+      return (0);
+    }
+    sock_line_done = 1;
+    return (1);
+  }
+
+  if (comm_buf_len < COMM_BUF_LEN) {
+    comm_buf[comm_buf_len++] = ch;
+    comm_buf[comm_buf_len] = 0x00;
+  }
+  // header of the incoming data in the GPRS_MODE_SINGLE: +IPD,<len>:
+  // data follow directly after the colon
+  if (ch == ':' && strncmp((char *)comm_buf, "+IPD,", 5) == 0) {
+    sock_rx_link = 0;
+    sock_rx_remain = atoi((char *)comm_buf + 5);
+    if (sock_rx_remain) sock_rx_state = SOCK_RX_DATA;
+    comm_buf_len = 0;
+    return (0);
+  }
+  // prompt for the data "> " is not finished by the new line
+  if (comm_buf_len == 2 && comm_buf[0] == '>' && comm_buf[1] == ' ') {
+    sock_line_done = 1;
+    return (1);
+  }
+  return (0);
+}
+
+/**********************************************************
+Method processes finished text line in the comm_buf:
+- state of the sockets: [<n>, ]CONNECT OK/CONNECT FAIL/
+  ALREADY CONNECT/CLOSED/CLOSE OK
+- new SMS notification +CMTI is stored for NextNewSMS()
+**********************************************************/
+void GSM::SockLine(void)
+{
+  char *p_char = (char *)comm_buf;
+  gprs_socket_t *sock;
+
+  if (strncmp(p_char, "+CMTI:", 6) == 0) {
+    p_char = strchr(p_char, ',');
+    if (p_char != NULL && atoi(p_char + 1) > 0) AddNewSMS(atoi(p_char + 1));
+    return;
+  }
+  // status report in the text mode for CheckDeliveryReports()
+  if (strncmp(p_char, "+CDS:", 5) == 0) {
+    ScanCDS(p_char);
+    return;
+  }
+
+  // new data in the manual mode: +CIPRXGET: 1[,<n>]
+  if (strncmp(p_char, "+CIPRXGET: 1", 12) == 0) {
+    p_char = strchr(p_char, ',');
+    if (p_char == NULL && sock_num) sock_table[0].flags |= SOCK_FLAG_RX_PENDING;
+    else if (p_char != NULL && atoi(p_char + 1) < sock_num) {
+      sock_table[atoi(p_char + 1)].flags |= SOCK_FLAG_RX_PENDING;
+    }
+    return;
+  }
+
+  if (gprs_mode == GPRS_MODE_MULTI) {
+    // <n>, <status>
+    if (p_char[0] < '0' || p_char[0] > '9' || p_char[1] != ',' || p_char[2] != ' ') return;
+    if (p_char[0] - '0' >= sock_num) return;
+    sock = &sock_table[p_char[0] - '0'];
+    p_char += 3;
+  }
+  else {
+    // <status> of the only socket
+    if (sock_num == 0) return;
+    sock = &sock_table[0];
+  }
+
+  if (strcmp(p_char, "CONNECT OK") == 0 || strcmp(p_char, "ALREADY CONNECT") == 0) {
+    sock->state = SOCK_CONNECTED;
+  }
+  else if (strcmp(p_char, "CONNECT FAIL") == 0 || strcmp(p_char, "CLOSED") == 0) {
+    sock->state = SOCK_CLOSED;
+  }
+  else if (strcmp(p_char, "CLOSE OK") == 0) {
+    sock->state = SOCK_FREE;
+  }
+}
+
+/**********************************************************
+Method passes collected chunk of data(comm_buf) to the sink
+If the sink returns GPRS_SINK_PAUSE no other data are fetched
+for the socket until SocketResume(), rest of the current frame
+is stored in the receive buffer of the socket(see SockRxByte())
+**********************************************************/
+void GSM::SockDeliver(void)
+{
+  if (comm_buf_len == 0) return;
+  if (sock_sink(sock_rx_link, comm_buf, comm_buf_len) == GPRS_SINK_PAUSE
+      && sock_rx_link < sock_num) {
+    sock_table[sock_rx_link].flags |= SOCK_FLAG_RX_PAUSED;
+  }
+  comm_buf_len = 0;
+}
+
+/**********************************************************
+Method processes one received character if there is some
+
+Chunk of data for the sink is delivered as soon as there
+is no other received character, so the sink doesn't wait
+for the end of the frame.
+
+return: 1 - text line was finished and processed
+        0 - otherwise
+**********************************************************/
+byte GSM::SockRx(void)
+{
+  if (!outSerial.available()) {
+    if (sock_rx_state == SOCK_RX_DATA && sock_sink != NULL) SockDeliver();
+    return (0);
+  }
+  if (!SockRxByte(outSerial.read())) return (0);
+  SockLine();
+  return (1);
+}
+
+/**********************************************************
+Method waits for the response in the GPRS_MODE_MULTI
+and GPRS_MODE_SINGLE
+Incoming data and state changes of all sockets are processed
+during waiting.
+
+tmout:    max. time of waiting (msec.)
+expected: line which is expected
+fail:     line which means error(besides "ERROR"), can be NULL
+
+return: RX_FINISHED_STR_RECV     - expected line was received
+        RX_FINISHED_STR_NOT_RECV - error line was received
+        RX_TMOUT_ERR             - nothing expected within tmout
+**********************************************************/
+byte GSM::SockWait(uint16_t tmout, char const *expected, char const *fail)
+{
+  unsigned long start = millis();
+
+  while ((unsigned long)(millis() - start) < tmout) {
+    if (!SockRx()) continue;
+
+    if (strcmp((char *)comm_buf, expected) == 0) return (RX_FINISHED_STR_RECV);
+    if (IsErrorLine((char *)comm_buf)
+        || (fail != NULL && strcmp((char *)comm_buf, fail) == 0)) {
+      return (RX_FINISHED_STR_NOT_RECV);
     }
-    return (-1);
   }
-  else return (-1);
+  return (RX_TMOUT_ERR);
 }
 
+/**********************************************************
+Method prepares status line of the socket:
+"<n>, <status>" in the GPRS_MODE_MULTI, "<status>" otherwise
+**********************************************************/
+void GSM::SockStatus(char *str, byte socket, char const *status)
+{
+  if (gprs_mode == GPRS_MODE_MULTI) sprintf(str, "%d, %s", socket, status);
+  else strcpy(str, status);
+}
+
+/**********************************************************
+Method sends the beginning of the socket AT command:
+"<cmd><n>," in the GPRS_MODE_MULTI, "<cmd>" otherwise
+**********************************************************/
+void GSM::SockCmd(const __FlashStringHelper *cmd, byte socket)
+{
+  outSerial.print(cmd);
+  if (gprs_mode == GPRS_MODE_MULTI) {
+    outSerial.print((int)socket);
+    outSerial.print(',');
+  }
+}
+
+/**********************************************************
+Method opens the socket in the GPRS_MODE_MULTI or
+GPRS_MODE_SINGLE
+The first free socket of the table is used.
+
+<socket type> - socket protocol type
+                0 - TCP
+                1 - UDP
+<remote port> - remote host port to be opened
+                0..65535 - port number
+<remote addr> - address of the remote host, string type. 
+              This parameter can be either:
+              - any valid IP address in the format: xxx.xxx.xxx.xxx
+              - any host name to be solved with a DNS query
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+        -2 - there is no free socket
+        -3 - socket was not opened
+
+        OK ret val:
+        -----------
+        0.. handle of the opened socket
+
+
+an example of usage:
+        char telemetry;
+
+        telemetry = gsm.SocketOpen(TCP_SOCKET, 80, "www.google.com");
+        if (telemetry >= 0) {
+          gsm.SocketSend(telemetry, data, data_len);
+        }
+**********************************************************/
+char GSM::SocketOpen(byte socket_type, uint16_t remote_port, char* remote_addr)
+{
+  char ret_val = -1;
+  byte i;
+  byte num_of_sockets;
+  unsigned long start;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+
+  // only one socket in the GPRS_MODE_SINGLE
+  num_of_sockets = sock_num;
+  if (gprs_mode != GPRS_MODE_MULTI && num_of_sockets > 1) num_of_sockets = 1;
+  for (i = 0; i < num_of_sockets; i++) {
+    if (sock_table[i].state == SOCK_FREE) break;
+  }
+  if (i == num_of_sockets) return (-2);
+
+  SockLock();
+  sock_table[i].state = SOCK_CONNECTING;
+  sock_table[i].flags = 0;
+  sock_table[i].rx_len = 0;
+  sock_table[i].rx_lost = 0;
+  sock_table[i].tx_window = 0;
+  sock_table[i].tx_sent = 0;
+  sock_table[i].tx_acked = 0;
+
+  // AT+CIPSTART=[<n>,]"TCP","www.google.com","80"
+  SockCmd(F("AT+CIPSTART="), i);
+  outSerial.print(socket_type == UDP_SOCKET ? F("\"UDP\",\"") : F("\"TCP\",\""));
+  outSerial.print(remote_addr);
+  outSerial.print(F("\",\""));
+  outSerial.print(remote_port);
+  outSerial.print(F("\"\r"));
+
+  ret_val = -3;
+  if (RX_FINISHED_STR_RECV == SockWait(START_LONG_COMM_TMOUT, "OK", NULL)) {
+    // result of the connection: [<n>, ]CONNECT OK or ALREADY CONNECT
+    // means connected, [<n>, ]CONNECT FAIL closed - the state
+    // is changed by SockLine() so waiting finishes with any of them
+    start = millis();
+    while (sock_table[i].state == SOCK_CONNECTING
+           && (unsigned long)(millis() - start) < 20000) {
+      if (SockRx() && IsErrorLine((char *)comm_buf)) break;
+    }
+    if (sock_table[i].state == SOCK_CONNECTED) ret_val = i;
+  }
+  if (ret_val < 0 && sock_table[i].state == SOCK_CONNECTING) {
+    // command was not accepted or there is no result
+    // - the socket is closed by SocketClose()
+    sock_table[i].state = SOCK_CLOSED;
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method closes the socket in the GPRS_MODE_MULTI or
+GPRS_MODE_SINGLE
+Unread data are discarded and the socket is free again.
+
+socket:   handle of the socket
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0 - socket was not closed by the GSM module
+            (but it is free in the table)
+        1 - socket was closed
+**********************************************************/
+char GSM::SocketClose(byte socket)
+{
+  char ret_val = -1;
+  char expected[20];
+
+  if (socket >= sock_num) return (0);
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+
+  ret_val = 1;
+  if (sock_table[socket].state != SOCK_FREE && sock_table[socket].state != SOCK_CLOSED) {
+    SockLock();
+    // quick close: AT+CIPCLOSE=[<n>,]1
+    SockCmd(F("AT+CIPCLOSE="), socket);
+    outSerial.print(F("1\r"));
+    SockStatus(expected, socket, "CLOSE OK");
+    if (RX_FINISHED_STR_RECV != SockWait(START_XLONG_COMM_TMOUT, expected, NULL)) ret_val = 0;
+    SetCommLineStatus(CLS_FREE);
+  }
+  sock_table[socket].state = SOCK_FREE;
+  sock_table[socket].flags = 0;
+  sock_table[socket].rx_len = 0;
+  return (ret_val);
+}
+
+/**********************************************************
+Methods send data to the socket in the GPRS_MODE_MULTI or
+GPRS_MODE_SINGLE
+Data are sent by AT+CIPSEND=[<n>,]<len>, longer data are
+split to SOCK_SEND_MAX_LEN parts. Every part is sent only
+after the prompt "> " and the next one after SEND OK.
+In the quick send mode(see SetQuickSend()) the next part
+is sent after DATA ACCEPT, i.e. as soon as the part is in the
+buffer of the module, and parts are limited by the free space
+of this buffer(AT+CIPSEND?).
+Incoming data of all sockets are received during sending.
+There are 2 modification with possibility to send:
+- certain size of binary data buffer
+- list of segments from the RAM or the flash(PROGMEM),
+  one part can contain data of several segments and one
+  segment can be split to several parts
+
+socket:       handle of the socket
+data_buffer:  data to be sent
+size:         number of bytes
+segs:         list of the segments(see SendData())
+num_of_segs:  number of the segments
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - data were not sent(socket is not connected, SEND FAIL)
+
+        OK ret val:
+        -----------
+        number of sent bytes
+**********************************************************/
+int GSM::SocketSend(byte socket, byte* data_buffer, uint16_t size)
+{
+  gprs_seg_t seg;
+
+  seg.data = data_buffer;
+  seg.len = size;
+  seg.src = GPRS_SEG_RAM;
+  if (size == 0) return (0);
+  return (SocketSend(socket, &seg, 1));
+}
+
+int GSM::SocketSend(byte socket, gprs_seg_t *segs, byte num_of_segs)
+{
+  int ret_val = -1;
+  char expected[24];
+  char fail[24];
+  uint16_t size = 0;
+  uint16_t len;
+  uint16_t part;
+  uint16_t sent = 0;
+  byte seg = 0;
+  uint16_t pos = 0;     // position in the current segment
+  uint16_t written;
+  byte status;
+  gprs_socket_t *sock;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  if (socket >= sock_num || sock_table[socket].state != SOCK_CONNECTED) return (-3);
+  sock = &sock_table[socket];
+
+  for (len = 0; len < num_of_segs; len++) size += SegLen(&segs[len]);
+
+  SockLock();
+  SockStatus(expected, socket, "SEND OK");
+  SockStatus(fail, socket, "SEND FAIL");
+  while (sent < size) {
+    len = size - sent;
+    if (len > SOCK_SEND_MAX_LEN) len = SOCK_SEND_MAX_LEN;
+    if (gprs_qsend) {
+      // pipelining is limited by the free space in the module
+      if (sock->tx_window < len) {
+        status = SockWindow(socket);
+        if (status != RX_FINISHED_STR_RECV) break;
+      }
+      if (len > sock->tx_window) len = sock->tx_window;
+      // DATA ACCEPT:[<n>,]<len>
+      if (gprs_mode == GPRS_MODE_MULTI) sprintf(expected, "DATA ACCEPT:%d,%u", socket, len);
+      else sprintf(expected, "DATA ACCEPT:%u", len);
+    }
+
+    // AT+CIPSEND=[<n>,]<len> and wait for the prompt "> "
+    SockCmd(F("AT+CIPSEND="), socket);
+    outSerial.print(len);
+    outSerial.print('\r');
+    status = SockWait(START_LONG_COMM_TMOUT, "> ", NULL);
+    if (status == RX_FINISHED_STR_RECV) {
+      // data of the part from one or more segments
+      for (part = 0; part < len; ) {
+        if (pos == SegLen(&segs[seg])) {
+          seg++;
+          pos = 0;
+          continue;
+        }
+        written = SegWrite(&segs[seg], pos, len - part);
+        pos += written;
+        part += written;
+      }
+      status = SockWait(START_XXLONG_COMM_TMOUT, expected, fail);
+    }
+    if (status != RX_FINISHED_STR_RECV) break;
+    sent += len;
+    if (gprs_qsend) sock->tx_window -= len;
+  }
+  SetCommLineStatus(CLS_FREE);
+
+  if (sent == size) ret_val = sent;
+  else if (status == RX_TMOUT_ERR) ret_val = -2;
+  else ret_val = -3;
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads received data of the socket
+Data are moved from the receive buffer of the socket
+to the user buffer.
+
+socket:       handle of the socket
+data_buffer:  buffer for the data
+max_size:     size of the buffer
+
+return: number of read bytes
+
+
+an example of usage:
+        byte data[32];
+        uint16_t len;
+
+        gsm.PollSockets();
+        len = gsm.SocketRead(telemetry, data, sizeof(data));
+**********************************************************/
+uint16_t GSM::SocketRead(byte socket, byte* data_buffer, uint16_t max_size)
+{
+  gprs_socket_t *sock;
+  uint16_t len;
+
+  if (socket >= sock_num) return (0);
+  sock = &sock_table[socket];
+  len = sock->rx_len;
+  if (len > max_size) len = max_size;
+  memcpy(data_buffer, sock->rx_buf, len);
+  sock->rx_len -= len;
+  memmove(sock->rx_buf, sock->rx_buf + len, sock->rx_len);
+  return (len);
+}
+
+/**********************************************************
+Method returns number of received bytes of the socket
+which were not read yet
+**********************************************************/
+uint16_t GSM::SocketAvailable(byte socket)
+{
+  if (socket >= sock_num) return (0);
+  return (sock_table[socket].rx_len);
+}
+
+/**********************************************************
+Method returns state of the socket
+
+return: SOCK_FREE, SOCK_CONNECTING, SOCK_CONNECTED, SOCK_CLOSED
+**********************************************************/
+byte GSM::SocketState(byte socket)
+{
+  if (socket >= sock_num) return (SOCK_FREE);
+  return (sock_table[socket].state);
+}
+
+/**********************************************************
+Method processes all characters received from the GSM module
+in the GPRS_MODE_MULTI or GPRS_MODE_SINGLE: incoming data are placed to the
+receive buffers of the sockets, socket states are updated
+(e.g. remote side closed the connection) and new SMS
+notifications are stored for NextNewSMS().
+
+Method is intended to be called from every pass of the loop(),
+it doesn't wait if nothing was received. Only started data
+frame or line is waited for (max. SOCK_FRAME_TMOUT between
+characters) so it is not mixed with the next AT command.
+In the manual receive mode(SetSocketFlowControl()) waiting
+data are read from the module as well.
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0  - nothing was received
+        1  - something was received
+
+
+an example of usage:
+        void loop()
+        {
+          gsm.PollSockets();
+          if (gsm.SocketAvailable(command_channel)) {
+            ...
+          }
+          if (gsm.SocketState(command_channel) == SOCK_CLOSED) {
+            gsm.SocketClose(command_channel);
+          }
+        }
+**********************************************************/
+char GSM::PollSockets(void)
+{
+  char ret_val = -1;
+  unsigned long last_char;
+  gprs_socket_t *sock;
+  uint16_t len;
+  byte i;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  ret_val = 0;
+
+  if (comm_line_used) {
+    // other AT command could receive notifications of new data
+    for (i = 0; i < sock_num; i++) {
+      if (sock_table[i].state == SOCK_CONNECTED) sock_table[i].flags |= SOCK_FLAG_RX_PENDING;
+    }
+  }
+  SetCommLineStatus(CLS_ATCMD);
+  comm_line_used = 0;
+  if (outSerial.available()) {
+    ret_val = 1;
+    last_char = millis();
+    // read while something comes or data frame/line is not finished
+    while (outSerial.available()
+           || ((sock_rx_state == SOCK_RX_DATA || (!sock_line_done && comm_buf_len))
+               && (unsigned long)(millis() - last_char) < SOCK_FRAME_TMOUT)) {
+      if (outSerial.available()) last_char = millis();
+      SockRx();
+    }
+    // line is processed - new line starts with the next character
+    sock_line_done = 1;
+  }
+
+  // manual receive mode - data are read from the module only
+  // if the socket is not paused and there is a place for them
+  for (i = 0; i < sock_num; i++) {
+    sock = &sock_table[i];
+    if (!(sock->flags & SOCK_FLAG_RX_PENDING) || (sock->flags & SOCK_FLAG_RX_PAUSED)) continue;
+    // the rest of the frame must fit to the receive buffer
+    // also in case the sink pauses after the first character
+    len = SOCK_RX_BUF_LEN - sock->rx_len;
+    if (sock_sink != NULL) {
+      if (sock->rx_len) continue; // not delivered by SocketResume() yet
+      if (len > SOCK_FETCH_LEN) len = SOCK_FETCH_LEN;
+    }
+    if (len == 0) continue;
+
+    // AT+CIPRXGET=2,[<n>,]<len>
+    SockCmd(F("AT+CIPRXGET=2,"), i);
+    outSerial.print(len);
+    outSerial.print('\r');
+    if (RX_FINISHED_STR_NOT_RECV == SockWait(START_LONG_COMM_TMOUT, "OK", NULL)) {
+      // ERROR - connection doesn't exist any more
+      sock->flags &= ~SOCK_FLAG_RX_PENDING;
+      if (sock->state == SOCK_CONNECTED) sock->state = SOCK_CLOSED;
+    }
+    ret_val = 1;
+  }
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method sets the sink for the incoming socket data
+
+Every chunk of data is passed to the sink as soon as it is
+received, data are not stored in the receive buffers of the
+sockets. The sink can return GPRS_SINK_PAUSE if it is not
+able to accept other data - in the manual receive mode
+(see SetSocketFlowControl()) data stay in the GSM module
+until SocketResume() is called, the remote side is stopped
+by the TCP window then. Rest of the already fetched data
+(max. SOCK_RX_BUF_LEN bytes are fetched at once) is kept in the
+receive buffer of the socket and passed to the sink by
+SocketResume(). Pausing is lossless only in the manual receive
+mode - otherwise the module keeps sending the data.
+
+sink:   function called for every chunk
+        NULL - data are stored in the receive buffers
+
+
+an example of usage:
+        byte SaveData(byte socket, byte *data, uint16_t len)
+        {
+          if (!WriteToCard(data, len)) return (GPRS_SINK_PAUSE);
+          return (GPRS_SINK_CONTINUE);
+        }
+
+        gsm.SetSocketSink(SaveData);
+**********************************************************/
+void GSM::SetSocketSink(gprs_sink_t sink)
+{
+  sock_sink = sink;
+}
+
+/**********************************************************
+Method enables or disables manual receive mode(AT+CIPRXGET)
+
+In the manual mode the GSM module keeps incoming data and
+sends only notification, data are read by the PollSockets()
+only if the socket is not paused and there is a place for
+them in the receive buffer. So no data are lost if the sketch
+is slower than the remote side.
+
+Method must be called before the socket is opened.
+
+enable:   1 - manual mode, 0 - data are sent by the module at once
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0 - mode was not set
+        1 - mode was set
+**********************************************************/
+char GSM::SetSocketFlowControl(byte enable)
+{
+  char ret_val = -1;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = SendATCmdWaitResp(enable ? "AT+CIPRXGET=1" : "AT+CIPRXGET=0", 1000, 100, "OK", 2);
+  if (ret_val == AT_RESP_OK) ret_val = 1;
+  else ret_val = 0;
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method resumes reading of the socket paused by the sink
+Data received after the pause are passed to the sink first.
+**********************************************************/
+void GSM::SocketResume(byte socket)
+{
+  gprs_socket_t *sock;
+
+  if (socket >= sock_num) return;
+  sock = &sock_table[socket];
+  sock->flags &= ~SOCK_FLAG_RX_PAUSED;
+  if (sock_sink != NULL && sock->rx_len) {
+    if (sock_sink(socket, sock->rx_buf, sock->rx_len) == GPRS_SINK_PAUSE) {
+      sock->flags |= SOCK_FLAG_RX_PAUSED;
+    }
+    sock->rx_len = 0;
+  }
+}
+
+/**********************************************************
+Method receives data in the transparent mode and passes
+every chunk to the sink as soon as it is received
+- unlike RcvData() data are not limited by the COMM_BUF_LEN
+  and the sink doesn't wait for the inter-character timeout
+
+start_comm_tmout:     max. time for the first character (msec.)
+max_interchar_tmout:  receiving is finished if there is no other
+                      character within this time (msec.)
+sink:                 function called for every chunk(socket is 0),
+                      if it returns GPRS_SINK_PAUSE receiving is
+                      finished at once, other data stay in the serial
+                      line - there is no flow control in the transparent
+                      mode(AT+IFC is not used), so the module keeps
+                      sending and data which don't fit to the serial
+                      receive buffer are lost, use GPRS_MODE_SINGLE
+                      or GPRS_MODE_MULTI(manual receive mode) if
+                      the sink must pause without a loss
+
+return: 
+        number of received bytes
+
+
+an example of usage:
+        byte SaveData(byte socket, byte *data, uint16_t len)
+        {
+          ...
+          return (GPRS_SINK_CONTINUE);
+        }
+
+        gsm.SendData("GET / HTTP/1.1\r\nHost: www.google.com\r\n\r\n");
+        gsm.RcvDataStream(20000, 1000, SaveData);
+**********************************************************/
+uint16_t GSM::RcvDataStream(uint16_t start_comm_tmout, uint16_t max_interchar_tmout, gprs_sink_t sink)
+{
+  unsigned long last_char = millis();
+  uint16_t tmout = start_comm_tmout;
+  uint16_t received = 0;
+  uint16_t len;
+
+  FlushData();
+  while ((unsigned long)(millis() - last_char) < tmout) {
+    len = outSerial.available();
+    if (len == 0) continue;
+
+    if (len > COMM_BUF_LEN) len = COMM_BUF_LEN;
+    for (comm_buf_len = 0; comm_buf_len < len; comm_buf_len++) {
+      comm_buf[comm_buf_len] = outSerial.read();
+    }
+    comm_buf[comm_buf_len] = 0x00;
+    received += len;
+    last_char = millis();
+    tmout = max_interchar_tmout;
+
+    // check <CR><LF>NO CARRIER<CR><LF>
+    CarrierRx(comm_buf, comm_buf_len);
+    if (sink(0, comm_buf, len) == GPRS_SINK_PAUSE) break;
+  }
+  CarrierLost();
+  return (received);
+}
+
+/**********************************************************
+Method initializes the matcher of the delimiter
+Matcher keeps its state between chunks of data so the
+delimiter is found even if it is split to two chunks.
+Failure table(KMP) is prepared so every character is checked
+only once, also for delimiters like "\r\n\r\n".
+
+match:      pointer to the matcher
+delimiter:  delimiter string, max. GPRS_MATCH_MAX_LEN characters
+            (longer delimiter is never found)
+
+
+an example of usage:
+        gprs_match_t header_end;
+
+        gsm.MatchInit(&header_end, "\r\n\r\n");
+**********************************************************/
+void GSM::MatchInit(gprs_match_t *match, char const *delimiter)
+{
+  byte i;
+  byte k = 0;
+
+  match->pattern = delimiter;
+  match->len = strlen(delimiter);
+  if (match->len > GPRS_MATCH_MAX_LEN) match->len = 0;
+  match->matched = 0;
+  match->found = 0;
+
+  // fail[i] - length of the longest proper prefix of the delimiter
+  // which is also suffix of the delimiter[0..i]
+  if (match->len) match->fail[0] = 0;
+  for (i = 1; i < match->len; i++) {
+    while (k && delimiter[i] != delimiter[k]) k = match->fail[k - 1];
+    if (delimiter[i] == delimiter[k]) k++;
+    match->fail[i] = k;
+  }
+}
+
+/**********************************************************
+Method passes one character to the matcher
+
+return: 1 - delimiter was just finished by this character
+        0 - delimiter was not found yet
+**********************************************************/
+byte GSM::MatchByte(gprs_match_t *match, byte ch)
+{
+  if (match->len == 0) return (0);
+  while (match->matched && ch != (byte)match->pattern[match->matched]) {
+    match->matched = match->fail[match->matched - 1];
+  }
+  if (ch == (byte)match->pattern[match->matched]) match->matched++;
+  if (match->matched == match->len) {
+    // next delimiter can overlap this one
+    match->matched = match->fail[match->len - 1];
+    match->found = 1;
+    return (1);
+  }
+  return (0);
+}
+
+/**********************************************************
+Method passes chunk of data to the matcher
+It can be used e.g. in the sink - see SetSocketSink()
+
+return: -1 - delimiter was not found in the chunk
+        >= 0 - number of bytes of the chunk up to the end
+               of the delimiter
+**********************************************************/
+int GSM::MatchData(gprs_match_t *match, byte *data, uint16_t len)
+{
+  uint16_t i;
+
+  for (i = 0; i < len; i++) {
+    if (MatchByte(match, data[i])) return (i + 1);
+  }
+  return (-1);
+}
+
+/**********************************************************
+Method receives data in the transparent mode until
+the delimiter or the required number of bytes is received
+
+Receiving is finished as soon as the data are complete,
+the timeouts are used only if the data are not complete.
+
+start_comm_tmout:     max. time for the first character (msec.)
+max_interchar_tmout:  max. time between characters (msec.)
+data_buffer:          buffer for the data
+len:                  size of the buffer - if delimiter is NULL
+                      receiving is finished after len bytes
+delimiter:            matcher initialized by MatchInit() or NULL,
+                      delimiter is included in the data,
+                      delimiter->found is 1 if it was received
+
+return: 
+        number of received bytes
+
+
+an example of usage:
+        gprs_match_t header_end;
+        byte header[300];
+
+        gsm.MatchInit(&header_end, "\r\n\r\n");
+        len = gsm.RcvDataUntil(20000, 1000, header, sizeof(header), &header_end);
+        if (header_end.found) {
+          // complete HTTP header was received
+        }
+**********************************************************/
+uint16_t GSM::RcvDataUntil(uint16_t start_comm_tmout, uint16_t max_interchar_tmout,
+                           byte *data_buffer, uint16_t len, gprs_match_t *delimiter)
+{
+  unsigned long last_char = millis();
+  uint16_t tmout = start_comm_tmout;
+  uint16_t received = 0;
+  byte ch;
+
+  FlushData();
+  if (delimiter != NULL) delimiter->found = 0;
+  while (received < len && (unsigned long)(millis() - last_char) < tmout) {
+    if (!outSerial.available()) continue;
+
+    ch = outSerial.read();
+    data_buffer[received++] = ch;
+    CarrierRx(&ch, 1);
+    last_char = millis();
+    tmout = max_interchar_tmout;
+    if (delimiter != NULL && MatchByte(delimiter, ch)) break;
+  }
+
+  // check <CR><LF>NO CARRIER<CR><LF>
+  CarrierLost();
+  return (received);
+}
+
+/**********************************************************
+Method reads data of the socket until the delimiter or
+the required number of bytes is received
+(GPRS_MODE_MULTI and GPRS_MODE_SINGLE without the sink)
+
+Incoming data are processed by the PollSockets() during
+waiting, method returns as soon as the data are complete,
+the socket is closed or the timeout elapses.
+
+socket:       handle of the socket
+data_buffer:  buffer for the data
+len:          size of the buffer - if delimiter is NULL
+              method waits for len bytes
+delimiter:    matcher initialized by MatchInit() or NULL,
+              delimiter is included in the data,
+              delimiter->found is 1 if it was received
+tmout:        max. time of waiting (msec.)
+
+return: 
+        number of read bytes
+
+
+an example of usage:
+        gprs_match_t line_end;
+        byte line[64];
+        byte frame_len[2];
+
+        // line based reply
+        gsm.MatchInit(&line_end, "\r\n");
+        len = gsm.SocketReadUntil(command, line, sizeof(line), &line_end, 5000);
+
+        // length prefixed frame
+        if (gsm.SocketReadUntil(command, frame_len, 2, NULL, 5000) == 2) {
+          len = gsm.SocketReadUntil(command, frame, frame_len[0] << 8 | frame_len[1], NULL, 5000);
+        }
+**********************************************************/
+uint16_t GSM::SocketReadUntil(byte socket, byte *data_buffer, uint16_t len,
+                              gprs_match_t *delimiter, uint16_t tmout)
+{
+  unsigned long start = millis();
+  gprs_socket_t *sock;
+  uint16_t received = 0;
+  uint16_t i;
+  byte found = 0;
+
+  if (socket >= sock_num) return (0);
+  sock = &sock_table[socket];
+  if (delimiter != NULL) delimiter->found = 0;
+
+  while (received < len && !found) {
+    // take the data from the receive buffer up to the delimiter
+    for (i = 0; i < sock->rx_len && received < len; i++) {
+      data_buffer[received++] = sock->rx_buf[i];
+      if (delimiter != NULL && MatchByte(delimiter, sock->rx_buf[i])) {
+        found = 1;
+        i++;
+        break;
+      }
+    }
+    sock->rx_len -= i;
+    memmove(sock->rx_buf, sock->rx_buf + i, sock->rx_len);
+    if (received == len || found) break;
+
+    if (sock->state != SOCK_CONNECTED && !(sock->flags & SOCK_FLAG_RX_PENDING)) break;
+    if ((unsigned long)(millis() - start) >= tmout) break;
+    PollSockets();
+  }
+  return (received);
+}
+
+/**********************************************************
+Methods for the detection of the NO CARRIER in the data mode
+
+If the DCD pin is connected(InitCarrierDetect()) the end
+of the connection is given only by the pin.
+
+Otherwise module sends <CR><LF>NO CARRIER<CR><LF> as the last
+string when the connection is closed. The matcher keeps its
+state between the received chunks, so the string split to two
+chunks is found too. But the same text can be also a part
+of the payload, therefore it is accepted only if no other
+data follow within the GPRS_CARRIER_GUARD_TIME. This is
+a heuristic only - the payload which contains NO CARRIER
+followed by a longer gap closes the data mode although
+the connection is still opened. Each check after the text
+was matched blocks for up to GPRS_CARRIER_GUARD_TIME.
+(in the GPRS_MODE_SINGLE and GPRS_MODE_MULTI the payload
+is framed by +IPD/+RECEIVE and status texts are never
+mixed with the data)
+**********************************************************/
+void GSM::CarrierReset(void)
+{
+  gprs_carrier.matched = 0;
+  gprs_carrier_seen = 0;
+}
+
+void GSM::CarrierRx(byte *data, uint16_t len)
+{
+  uint16_t i;
+
+  for (i = 0; i < len; i++) {
+    // other data after NO CARRIER => it was a payload
+    gprs_carrier_seen = MatchByte(&gprs_carrier, data[i]);
+  }
+}
+
+/**********************************************************
+return: 1 - NO CARRIER was confirmed, comm. line is FREE
+        0 - connection is still opened
+**********************************************************/
+byte GSM::CarrierLost(void)
+{
+  unsigned long start = millis();
+
+  if (gprs_dcd_pin != GPRS_NO_DCD) {
+    // DCD can't be faked by the payload
+    if (CLS_DATA != GetCommLineStatus()) return (0);
+    if (digitalRead(gprs_dcd_pin) == GPRS_DCD_ACTIVE) return (0);
+  }
+  else {
+    if (!gprs_carrier_seen) return (0);
+    while ((unsigned long)(millis() - start) < GPRS_CARRIER_GUARD_TIME) {
+      // data continue - NO CARRIER was probably a part of the payload
+      if (outSerial.available()) return (0);
+    }
+  }
+  // NO CARRIER was received => socket was closed from the host side
+  // we can set the communication line to the FREE state
+  CarrierReset();
+  gprs_keep_addr = NULL;
+  SetCommLineStatus(CLS_FREE);
+  return (1);
+}
+
+/**********************************************************
+Methods for the segments of the data - see SendData()
+
+SegLen() returns length of the segment, segment with
+the length 0 is a string finished by 0x00
+
+SegWrite() writes max. len bytes of the segment from the
+position pos to the serial line and returns number of
+written bytes
+**********************************************************/
+uint16_t GSM::SegLen(gprs_seg_t *seg)
+{
+  if (seg->len) return (seg->len);
+  if (seg->src == GPRS_SEG_PGM) return (strlen_P((const char *)seg->data));
+  return (strlen((const char *)seg->data));
+}
+
+uint16_t GSM::SegWrite(gprs_seg_t *seg, uint16_t pos, uint16_t len)
+{
+  const byte *data = (const byte *)seg->data + pos;
+  uint16_t i;
+
+  if (len > SegLen(seg) - pos) len = SegLen(seg) - pos;
+  if (seg->src == GPRS_SEG_PGM) {
+    for (i = 0; i < len; i++) outSerial.write(pgm_read_byte(data + i));
+  }
+  else outSerial.write(data, len);
+  return (len);
+}
+
+/**********************************************************
+Method initializes the send buffer for the transparent mode
+
+Small data written by the BufferData() are collected in the
+buffer and passed to the module together(Nagle-style), so
+they are sent in one TCP segment instead of many small ones.
+Buffer is flushed:
+- when it is full
+- flush_tmout msec. after the first not sent byte was buffered
+  (checked by BufferData() and PollSendBuffer())
+- by FlushData() and before every receiving by RcvData...()
+  and before leaving of the data mode
+
+Packing of the module(AT+CIPCCFG) is configured to match:
+the module sends the data as soon as the full buffer is
+received(<SendSz> = size) and waits only the shortest time
+(<WaitTm> = 100 msec.) for the rest of the flushed data.
+Method must be called when the comm. line is free(e.g. after
+InitGPRS(), before OpenSocket()).
+
+buffer:       buffer allocated by the user, NULL - no buffering
+size:         size of the buffer(max. GPRS_PACK_MAX_SIZE)
+flush_tmout:  max. delay of the buffered data (msec.)
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0 - packing of the module was not configured
+        1 - send buffer is ready
+
+
+an example of usage:
+        byte tx_buffer[256];
+
+        gsm.InitGPRS("internet", "", "");
+        gsm.InitSendBuffer(tx_buffer, sizeof(tx_buffer), 2000);
+        gsm.OpenSocket(TCP_SOCKET, 8080, "telemetry.example.com");
+        ...
+        gsm.BufferData(record, record_len);
+**********************************************************/
+char GSM::InitSendBuffer(byte *buffer, uint16_t size, uint16_t flush_tmout)
+{
+  char ret_val = -1;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+
+  if (size > GPRS_PACK_MAX_SIZE) size = GPRS_PACK_MAX_SIZE;
+  gprs_tx_buf = buffer;
+  gprs_tx_size = size;
+  gprs_tx_len = 0;
+  gprs_tx_tmout = flush_tmout;
+  if (buffer != NULL) {
+    gprs_pack_wait = 1;
+    gprs_pack_size = size;
+  }
+  else {
+    gprs_pack_wait = GPRS_PACK_WAIT;
+    gprs_pack_size = GPRS_PACK_SIZE;
+  }
+  ret_val = SendPackCfg();
+  if (ret_val == AT_RESP_OK) ret_val = 1;
+  else ret_val = 0;
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Methods write data to the send buffer - see InitSendBuffer()
+There are 2 modification with possibility to send:
+- string (finished by the standard end character 0x00)
+- certain size of binary data buffer
+If the send buffer is not initialized data are sent at once.
+Buffered data are kept while the data mode is left(see
+LeaveDataMode()) and sent after ReturnToDataMode().
+
+return: number of accepted bytes - less than size only if
+        the buffer is full and the module is not in the data mode
+
+
+an example of usage:
+        gsm.BufferData("T=21.5;");
+        gsm.BufferData(buffer, 20);
+**********************************************************/
+uint16_t GSM::BufferData(char* str_data)
+{
+  return (BufferData((byte *)str_data, strlen(str_data)));
+}
+
+uint16_t GSM::BufferData(byte* data_buffer, uint16_t size)
+{
+  uint16_t accepted = 0;
+  uint16_t len;
+
+  if (gprs_tx_buf == NULL) {
+    SendData(data_buffer, size);
+    gprsTxFlushes++;
+    return (size);
+  }
+  while (accepted < size) {
+    if (gprs_tx_len == gprs_tx_size && FlushData() == 0) break;
+    if (gprs_tx_len == 0) gprs_tx_first = millis();
+    len = gprs_tx_size - gprs_tx_len;
+    if (len > size - accepted) len = size - accepted;
+    memcpy(gprs_tx_buf + gprs_tx_len, data_buffer + accepted, len);
+    gprs_tx_len += len;
+    accepted += len;
+  }
+  if (gprs_tx_len == gprs_tx_size) FlushData();
+  else PollSendBuffer();
+  return (accepted);
+}
+
+/**********************************************************
+Method sends all buffered data to the module
+(only in the data mode)
+
+return: number of sent bytes
+**********************************************************/
+uint16_t GSM::FlushData(void)
+{
+  uint16_t len = gprs_tx_len;
+
+  if (len == 0 || CLS_DATA != GetCommLineStatus()) return (0);
+  gprs_tx_len = 0;
+  SendData(gprs_tx_buf, len);
+  gprsTxFlushes++;
+  return (len);
+}
+
+/**********************************************************
+Method flushes the send buffer if the oldest buffered byte
+waits longer than flush_tmout - see InitSendBuffer()
+It should be called periodically from the loop() if
+BufferData() is not called often.
+**********************************************************/
+void GSM::PollSendBuffer(void)
+{
+  if (gprs_tx_len && (unsigned long)(millis() - gprs_tx_first) >= gprs_tx_tmout) {
+    FlushData();
+  }
+}
+
+/**********************************************************
+Method sends the packing parameters to the module
+AT+CIPCCFG=<NmRetry>,<WaitTm>,<SendSz>,<esc> - "+++" is enabled
+**********************************************************/
+char GSM::SendPackCfg(void)
+{
+  char cmd[30];
+
+  sprintf(cmd, "AT+CIPCCFG=5,%u,%u,1", gprs_pack_wait, gprs_pack_size);
+  return (SendATCmdWaitResp(cmd, 1000, 100, "OK", 2));
+}
+
+/**********************************************************
+Method enables the quick send mode(AT+CIPQSEND=1)
+for the GPRS_MODE_MULTI and GPRS_MODE_SINGLE
+
+SocketSend() doesn't wait for SEND OK(i.e. for the ACK of the
+server) but only for DATA ACCEPT, so more parts can be on the
+way at the same time. Number of the bytes which were not
+acknowledged by the server can be checked by SocketAck().
+Method should be called before SocketOpen().
+
+enable:   1 - quick send mode, 0 - normal mode(SEND OK)
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0 - mode was not accepted
+        1 - mode is set
+
+
+an example of usage:
+        gsm.InitGPRS("internet", "", "", GPRS_MODE_MULTI);
+        gsm.SetQuickSend(1);
+**********************************************************/
+char GSM::SetQuickSend(byte enable)
+{
+  char ret_val = -1;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = SendATCmdWaitResp(enable ? "AT+CIPQSEND=1" : "AT+CIPQSEND=0", 1000, 100, "OK", 2);
+  if (ret_val == AT_RESP_OK) {
+    gprs_qsend = enable;
+    ret_val = 1;
+  }
+  else ret_val = 0;
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads the acknowledgement state of the socket(AT+CIPACK)
+Counters of the socket tx_sent and tx_acked are updated.
+
+socket:   handle of the socket
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - state was not read(wrong socket)
+
+        OK ret val:
+        -----------
+        number of sent bytes which were not acknowledged yet
+
+
+an example of usage:
+        gsm.SocketSend(uplink, data, sizeof(data));
+        ...
+        if (gsm.SocketAck(uplink) == 0) {
+          // all data were received by the server
+        }
+**********************************************************/
+long GSM::SocketAck(byte socket)
+{
+  long ret_val = -1;
+  long values[3];
+  byte status;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  if (socket >= sock_num) return (-3);
+
+  SockLock();
+  // AT+CIPACK[=<n>] => +CIPACK: <txlen>,<acklen>,<nacklen>
+  outSerial.print(F("AT+CIPACK"));
+  if (gprs_mode == GPRS_MODE_MULTI) {
+    outSerial.print('=');
+    outSerial.print((int)socket);
+  }
+  outSerial.print('\r');
+  status = SockQuery("+CIPACK: ", -1, values, 3);
+  if (status == RX_FINISHED_STR_RECV) {
+    sock_table[socket].tx_sent = values[0];
+    sock_table[socket].tx_acked = values[1];
+    ret_val = values[2];
+  }
+  else if (status == RX_TMOUT_ERR) ret_val = -2;
+  else ret_val = -3;
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads the free space of the module tx buffer for the
+socket(AT+CIPSEND?) - it waits until some space is free
+**********************************************************/
+byte GSM::SockWindow(byte socket)
+{
+  unsigned long start = millis();
+  long window;
+  byte status;
+
+  do {
+    outSerial.print(F("AT+CIPSEND?\r"));
+    // +CIPSEND: [<n>,]<size> - line for every connection
+    status = SockQuery("+CIPSEND: ", gprs_mode == GPRS_MODE_MULTI ? socket : -1, &window, 1);
+    if (status != RX_FINISHED_STR_RECV) return (status);
+    sock_table[socket].tx_window = window;
+  } while (window == 0 && (unsigned long)(millis() - start) < START_XXLONG_COMM_TMOUT);
+  if (window == 0) return (RX_TMOUT_ERR);
+  return (RX_FINISHED_STR_RECV);
+}
+
+/**********************************************************
+Method reads the answer of the query command:
+<prefix>[<n>,]<value 1>[,<value 2>...] and OK
+
+prefix:         prefix of the line with values
+link:           <n> - only the line of this connection is used
+                -1 - there is no <n> in the line
+values:         read values
+num_of_values:  number of values
+
+return: RX_FINISHED_STR_RECV - values were read
+        RX_FINISHED_STR_NOT_RECV - ERROR or values were not found
+        RX_TMOUT_ERR - no answer
+**********************************************************/
+byte GSM::SockQuery(char const *prefix, int link, long *values, byte num_of_values)
+{
+  unsigned long start = millis();
+  byte prefix_len = strlen(prefix);
+  byte found = 0;
+  byte i;
+  char *p_char;
+
+  while ((unsigned long)(millis() - start) < START_LONG_COMM_TMOUT) {
+    if (!SockRx()) continue;
+
+    if (strcmp((char *)comm_buf, "OK") == 0) {
+      return (found ? RX_FINISHED_STR_RECV : RX_FINISHED_STR_NOT_RECV);
+    }
+    if (IsErrorLine((char *)comm_buf)) return (RX_FINISHED_STR_NOT_RECV);
+    if (strncmp((char *)comm_buf, prefix, prefix_len) != 0) continue;
+
+    p_char = (char *)comm_buf + prefix_len;
+    if (link >= 0) {
+      if (atoi(p_char) != link || (p_char = strchr(p_char, ',')) == NULL) continue;
+      p_char++;
+    }
+    for (i = 0; i < num_of_values && p_char != NULL; i++) {
+      values[i] = atol(p_char);
+      p_char = strchr(p_char, ',');
+      if (p_char != NULL) p_char++;
+    }
+    if (i == num_of_values) found = 1;
+  }
+  return (RX_TMOUT_ERR);
+}
+
+/**********************************************************
+Method keeps the connection(transparent mode) opened across
+requests - the socket is opened only if it is necessary
+
+Connection is reused if it is still alive:
+- in the data mode: stale data of the previous request are
+  discarded and NO CARRIER is checked(see CarrierLost())
+- after LeaveDataMode(): AT+CIPSTATUS must report CONNECT OK,
+  then the data mode is restored by ReturnToDataMode()
+Otherwise the previous connection is closed, GPRS context is
+activated again if it was lost(PDP DEACT) and the socket
+is opened by the OpenSocket().
+Remote address is compared by the content so the string
+must be valid until the next call.
+
+socket_type, remote_port, remote_addr: see OpenSocket()
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        0 - socket could not be opened
+        1 - opened connection is reused, module is in the data mode
+        2 - new connection was opened, module is in the data mode
+
+
+an example of usage:
+        char host[] = "www.google.com";
+
+        if (gsm.KeepSocket(TCP_SOCKET, 80, host) > 0) {
+          gsm.SendData("GET / HTTP/1.1\r\nHost: www.google.com\r\n\r\n");
+          len = gsm.RcvData(20000, 1000, &ptr_to_data);
+        }
+**********************************************************/
+char GSM::KeepSocket(byte socket_type, uint16_t remote_port, char* remote_addr)
+{
+  char ret_val = -1;
+  byte same;
+  byte ch;
+
+  same = (gprs_keep_addr != NULL && socket_type == gprs_keep_type
+          && remote_port == gprs_keep_port && strcmp(remote_addr, gprs_keep_addr) == 0);
+
+  if (CLS_DATA == GetCommLineStatus()) {
+    // stale data of the previous request
+    while (outSerial.available()) {
+      ch = outSerial.read();
+      CarrierRx(&ch, 1);
+    }
+    if (!CarrierLost()) {
+      if (same) return (1);
+      CloseSocket();
+    }
+  }
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+
+  if (gprs_escaped) {
+    // socket is opened in the command mode
+    if (same && CheckSocket() == GPRS_CONN_OPENED && ReturnToDataMode() == 1) return (1);
+    if (gprs_escaped) CloseSocket();
+  }
+
+  // new connection is necessary
+  if (CheckSocket() == GPRS_CONN_NO_CONTEXT) EnableGPRS(CLOSE_AND_REOPEN);
+  ret_val = OpenSocket(socket_type, remote_port, remote_addr);
+  if (ret_val == 1) {
+    gprs_keep_type = socket_type;
+    gprs_keep_port = remote_port;
+    gprs_keep_addr = remote_addr;
+    gprsConnects++;
+    ret_val = 2;
+  }
+  else gprs_keep_addr = NULL;
+  return (ret_val);
+}
+
+/**********************************************************
+Method checks the state of the connection(AT+CIPSTATUS)
+in the command mode
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line is not free
+
+        OK ret val:
+        -----------
+        GPRS_CONN_CLOSED - there is no connection
+        GPRS_CONN_OPENED - connection is opened(CONNECT OK)
+        GPRS_CONN_NO_CONTEXT - GPRS context is not active,
+                               EnableGPRS() must be called
+
+
+an example of usage:
+        if (gsm.LeaveDataMode() == 1) {
+          if (gsm.CheckSocket() == GPRS_CONN_OPENED) gsm.ReturnToDataMode();
+          else gsm.CloseSocket();
+        }
+**********************************************************/
+char GSM::CheckSocket(void)
+{
+  char ret_val = -1;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+
+  ret_val = GPRS_CONN_CLOSED;
+  // OK<CR><LF><CR><LF>STATE: <state>
+  if (AT_RESP_OK == SendATCmdWaitResp("AT+CIPSTATUS", 1000, 100, "STATE: ", 1)) {
+    if (strstr((char *)comm_buf, "CONNECT OK") != NULL) ret_val = GPRS_CONN_OPENED;
+    else if (strstr((char *)comm_buf, "PDP DEACT") != NULL
+             || strstr((char *)comm_buf, "IP INITIAL") != NULL) {
+      ret_val = GPRS_CONN_NO_CONTEXT;
+    }
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method reserves the comm. line for the socket method
+Socket methods read all incoming data by the SockRx() so
+they don't hide notifications from the PollSockets()
+- see InitGPRS()
+**********************************************************/
+void GSM::SockLock(void)
+{
+  byte used = comm_line_used;
+
+  SetCommLineStatus(CLS_ATCMD);
+  comm_line_used = used;
+}
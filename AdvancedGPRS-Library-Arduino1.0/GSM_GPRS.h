@@ -18,8 +18,13 @@
 #ifndef __GSM_GPRS
 #define __GSM_GPRS
 
+#if defined(ARDUINO) && ARDUINO >= 100
+  #include "Arduino.h"
+  #else
+  #include "WProgram.h"
+#endif
 
-#define GPRS_LIB_VERSION 102 // library version X.YY (e.g. 1.00)
+#define GPRS_LIB_VERSION 115 // library version X.YY (e.g. 1.00)
 /*
     Version
     --------------------------------------------------------------------------
@@ -33,16 +38,219 @@
     102       GPRS is a part of GSM class to avoid repeated inheritance in future
               (in case other module will be added, like GPS)
     --------------------------------------------------------------------------
+    103       Multi-connection mode(AT+CIPMUX=1): up to 6 sockets are opened
+              at the same time, incoming data(+RECEIVE,<n>,<len>:) are
+              demultiplexed to the receive buffers of the sockets
+    --------------------------------------------------------------------------
+    104       Non-transparent single connection mode: data are sent by
+              AT+CIPSEND=<len> and received as +IPD,<len>: frames, the comm.
+              line stays free for other AT commands during the session
+    --------------------------------------------------------------------------
+    105       Fast escape from the transparent mode: DTR pulse or "+++"
+              after the remaining guard time only, CloseSocket() doesn't
+              repeat the escape, LeaveDataMode()/ReturnToDataMode() added
+    --------------------------------------------------------------------------
+    106       Streaming receive: chunks of data are passed to the user sink
+              as soon as they are received, the sink can pause receiving
+              (manual receive mode AT+CIPRXGET keeps data in the module)
+    --------------------------------------------------------------------------
+    107       Receiving is finished by the delimiter or after required
+              number of bytes - RcvDataUntil(), SocketReadUntil(),
+              delimiter matcher keeps its state between chunks
+    --------------------------------------------------------------------------
+    108       StrInBin() uses the matcher(KMP) instead of the restart search,
+              NO CARRIER split between chunks is detected, NO CARRIER inside
+              the payload doesn't close the data mode(GPRS_CARRIER_GUARD_TIME)
+    --------------------------------------------------------------------------
+    109       Scatter-gather sending: SendData() and SocketSend() take a list
+              of segments from the RAM or the flash(PROGMEM)
+    --------------------------------------------------------------------------
+    110       Send buffer for the transparent mode: small writes are sent
+              together(size/time threshold, FlushData()), packing of the
+              module(AT+CIPCCFG) is configured to match the buffer
+    --------------------------------------------------------------------------
+    111       Quick send mode(AT+CIPQSEND=1): SocketSend() doesn't wait for
+              the ACK of the server, parts are limited by the free space
+              of the module(AT+CIPSEND?), SocketAck() reads AT+CIPACK
+    --------------------------------------------------------------------------
+    112       Persistent connection: KeepSocket() reuses the opened socket
+              and opens the new one only if NO CARRIER or AT+CIPSTATUS
+              reports that the connection was closed, CheckSocket() added
+    --------------------------------------------------------------------------
+    113       GPRS_MODE_SINGLE and GPRS_MODE_MULTI use the manual receive
+              mode(AT+CIPRXGET=1) so other AT commands never get the data,
+              PollSockets() reads all sockets after other AT commands
+    --------------------------------------------------------------------------
+    114       Paused sink doesn't get the rest of the fetched data, it is kept
+              in the receive buffer and passed to the sink by SocketResume()
+    --------------------------------------------------------------------------
+    115       NO CARRIER text followed by the silence is only a heuristic,
+              the carrier is confirmed by the DCD pin(AT&C1) if it is
+              connected - InitCarrierDetect()
+    --------------------------------------------------------------------------
 */
 
 // type of the socket
 #define  TCP_SOCKET 0
 #define  UDP_SOCKET 1
 
+// source of the data segment
+#define GPRS_SEG_RAM          0
+#define GPRS_SEG_PGM          1     // flash(PROGMEM)
+
+// one segment of the data - see SendData() and SocketSend()
+typedef struct
+{
+  const void *data;
+  uint16_t len;                     // 0 - string finished by 0x00
+  byte src;                         // GPRS_SEG_...
+} gprs_seg_t;
+
 // mode for the context activation
 #define CHECK_AND_OPEN    0
 #define CLOSE_AND_REOPEN  1
 
+// state of the connection - CheckSocket()
+#define GPRS_CONN_CLOSED      0     // there is no connection
+#define GPRS_CONN_OPENED      1     // CONNECT OK
+#define GPRS_CONN_NO_CONTEXT  2     // GPRS context is not active
+
+// DTR of the GSM module is not connected - InitFastEscape()
+#define GPRS_NO_DTR           0xFF
+
+// DCD of the GSM module is not connected - InitCarrierDetect()
+#define GPRS_NO_DCD           0xFF
+
+// level of the DCD pin when the carrier is present
+// (signals of the module's serial port are active in LOW)
+#ifndef GPRS_DCD_ACTIVE
+	#define GPRS_DCD_ACTIVE       LOW
+#endif // end of ifndef GPRS_DCD_ACTIVE
+
+// silence before and after the escape sequence "+++" (msec.)
+// it is given by the GSM module
+#ifndef GPRS_ESC_GUARD_TIME
+	#define GPRS_ESC_GUARD_TIME   1000
+#endif // end of ifndef GPRS_ESC_GUARD_TIME
+
+// max. time of the response to the DTR pulse (msec.)
+#ifndef GPRS_ESC_DTR_TMOUT
+	#define GPRS_ESC_DTR_TMOUT    200
+#endif // end of ifndef GPRS_ESC_DTR_TMOUT
+
+// default packing of the module in the transparent mode
+// AT+CIPCCFG <WaitTm>(x 100 msec.) and <SendSz>(bytes)
+#ifndef GPRS_PACK_WAIT
+	#define GPRS_PACK_WAIT        2
+#endif // end of ifndef GPRS_PACK_WAIT
+
+#ifndef GPRS_PACK_SIZE
+	#define GPRS_PACK_SIZE        1024
+#endif // end of ifndef GPRS_PACK_SIZE
+
+// max. <SendSz> accepted by the module
+#define GPRS_PACK_MAX_SIZE    1460
+
+// without the DCD pin: NO CARRIER in the data mode is taken as
+// the end of the connection if no other data follow within this
+// time (msec.) - it is a heuristic only, payload can contain
+// NO CARRIER followed by a longer gap, see CarrierLost()
+#ifndef GPRS_CARRIER_GUARD_TIME
+	#define GPRS_CARRIER_GUARD_TIME 100
+#endif // end of ifndef GPRS_CARRIER_GUARD_TIME
+
+// mode of the GPRS connection - InitGPRS()
+#define GPRS_MODE_TRANSPARENT 0   // one socket, OpenSocket() - line is in DATA state
+#define GPRS_MODE_MULTI       1   // up to SOCK_MAX_LINKS sockets, SocketOpen()
+#define GPRS_MODE_SINGLE      2   // one socket, SocketOpen() - line stays free
+
+// max. number of connections of the GSM module (AT+CIPMUX=1)
+#define SOCK_MAX_LINKS        6
+
+// size of the receive buffer of one socket
+#ifndef SOCK_RX_BUF_LEN
+	#define SOCK_RX_BUF_LEN       64
+#endif // end of ifndef SOCK_RX_BUF_LEN
+
+// max. length of data sent by one AT+CIPSEND
+#ifndef SOCK_SEND_MAX_LEN
+	#define SOCK_SEND_MAX_LEN     1024
+#endif // end of ifndef SOCK_SEND_MAX_LEN
+
+// max. length of data read from the module by one AT+CIPRXGET=2
+// in the manual receive mode when the sink is used, it is also limited
+// by SOCK_RX_BUF_LEN(rest of the data is kept there if the sink pauses)
+#ifndef SOCK_FETCH_LEN
+	#define SOCK_FETCH_LEN        COMM_BUF_LEN
+#endif // end of ifndef SOCK_FETCH_LEN
+
+// max. time between characters of one incoming data frame (msec.)
+#ifndef SOCK_FRAME_TMOUT
+	#define SOCK_FRAME_TMOUT      1000
+#endif // end of ifndef SOCK_FRAME_TMOUT
+
+// state of the socket
+enum sock_state_enum
+{
+  SOCK_FREE = 0,      // socket is not used
+  SOCK_CONNECTING,    // AT+CIPSTART was sent, result is not known yet
+  SOCK_CONNECTED,     // data can be sent and received
+  SOCK_CLOSED,        // closed by the remote side or connection failed
+                      // (received data can be still read)
+
+  SOCK_LAST_ITEM
+};
+
+// state of the socket receiver
+enum sock_rx_enum
+{
+  SOCK_RX_LINE = 0,   // text lines from the GSM module are received
+  SOCK_RX_DATA,       // data of the +RECEIVE frame are received
+
+  SOCK_RX_LAST_ITEM
+};
+
+// flags of the socket
+#define SOCK_FLAG_RX_PENDING  0x01  // data wait in the module(manual receive mode)
+#define SOCK_FLAG_RX_PAUSED   0x02  // sink paused receiving - SocketResume()
+
+// return values of the sink
+#define GPRS_SINK_PAUSE       0     // don't pass other data now
+#define GPRS_SINK_CONTINUE    1     // other data can be passed
+
+// sink for the incoming data - see SetSocketSink() and RcvDataStream()
+typedef byte (*gprs_sink_t)(byte socket, byte *data, uint16_t len);
+
+// max. length of the delimiter - see MatchInit()
+#ifndef GPRS_MATCH_MAX_LEN
+	#define GPRS_MATCH_MAX_LEN    16
+#endif // end of ifndef GPRS_MATCH_MAX_LEN
+
+// matcher of the delimiter in the received data
+// state is kept between chunks of data
+typedef struct
+{
+  char const *pattern;              // delimiter
+  byte len;                         // length of the delimiter
+  byte matched;                     // number of already matched characters
+  byte found;                       // 1 - delimiter was found
+  byte fail[GPRS_MATCH_MAX_LEN];    // failure table(KMP)
+} gprs_match_t;
+
+// one socket - index in the table is the connection number of the module
+// table is allocated by the user sketch, see InitSockets()
+typedef struct
+{
+  byte state;                     // SOCK_...
+  byte flags;                     // SOCK_FLAG_...
+  uint16_t rx_len;                // number of bytes in the rx_buf
+  uint16_t rx_lost;               // bytes discarded because rx_buf was full
+  uint16_t tx_window;             // free space in the module(quick send)
+  unsigned long tx_sent;          // sent bytes - updated by SocketAck()
+  unsigned long tx_acked;         // acknowledged bytes - updated by SocketAck()
+  byte rx_buf[SOCK_RX_BUF_LEN];
+} gprs_socket_t;
+
 
 
 #endif
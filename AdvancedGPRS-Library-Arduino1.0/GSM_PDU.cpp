@@ -0,0 +1,938 @@
+/*
+	GSM_PDU.cpp - SMS PDU mode library for the Advanced GPRS Shield - SiGAlabs
+	www.sigalabs.com
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GSM_PDU.h"
+#include "GSM.h"
+
+
+extern "C" {
+  #include <string.h>
+}
+
+
+// states of the PDU response reception
+#define PDU_RX_HEADER   0
+#define PDU_RX_HEX      1
+#define PDU_RX_TRAILER  2
+
+
+// GSM 7-bit default alphabet -> ISO 8859-1
+// characters without ISO 8859-1 equivalent (greek letters) are replaced by '?'
+static const byte gsm7_to_latin1[128] PROGMEM = {
+  0x40, 0xA3, 0x24, 0xA5, 0xE8, 0xE9, 0xF9, 0xEC, 0xF2, 0xC7, 0x0A, 0xD8, 0xF8, 0x0D, 0xC5, 0xE5,
+  0x3F, 0x5F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x1B, 0xC6, 0xE6, 0xDF, 0xC9,
+  0x20, 0x21, 0x22, 0x23, 0xA4, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+  0xA1, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0xC4, 0xD6, 0xD1, 0xDC, 0xA7,
+  0xBF, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0xE4, 0xF6, 0xF1, 0xFC, 0xE0
+};
+
+// ASCII -> GSM 7-bit default alphabet
+// bit 7 set means the character is placed in the extension table
+// so it must be sent as <ESC><code>, unknown characters are replaced by '?'
+static const byte ascii_to_gsm7[128] PROGMEM = {
+  0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x0A, 0x3F, 0x8A, 0x0D, 0x3F, 0x3F,
+  0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F,
+  0x20, 0x21, 0x22, 0x23, 0x02, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+  0x00, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0xBC, 0xAF, 0xBE, 0x94, 0x11,
+  0x3F, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0xA8, 0xC0, 0xA9, 0xBD, 0x3F
+};
+
+// GSM 7-bit extension table: pairs <code after ESC>, <ISO 8859-1 character>
+#define GSM7_EXT_NUM 9
+static const byte gsm7_ext_to_latin1[GSM7_EXT_NUM * 2] PROGMEM = {
+  0x0A, 0x0C,   0x14, '^',   0x28, '{',   0x29, '}',   0x2F, '\\',
+  0x3C, '[',    0x3D, '~',   0x3E, ']',   0x40, '|'
+};
+
+// phone number semi-octet digits
+static const char bcd_digits[] PROGMEM = "0123456789*#abc";
+
+
+
+/**********************************************************
+Method returns PDU library version
+
+return val: 100 means library version 1.00
+            101 means library version 1.01
+**********************************************************/
+int GSM::PDULibVer(void)
+{
+  return (PDU_LIB_VERSION);
+}
+
+
+/**********************************************************
+Method packs GSM 7-bit characters(septets) to octets
+
+dest:           pointer to the buffer where packed octets are placed
+septets:        pointer to the septets
+                dest may be the same as septets - packing can be made
+                in place
+num_of_septets: number of septets to be packed
+fill_bits:      number of fill bits inserted before the first septet
+                (used to align septets behind user data header)
+
+Septets are processed in blocks of 8 septets = 7 octets where
+each octet is composed by fixed shifts without bit-by-bit loop,
+only remaining septets are packed through the bit accumulator
+
+return:
+        number of packed octets
+**********************************************************/
+byte GSM::PackSeptets(byte *dest, byte *septets, byte num_of_septets, byte fill_bits)
+{
+  byte *p_dest = dest;
+  byte s[8];
+  byte i;
+  byte bits;
+  uint16_t acc;
+
+  if (fill_bits == 0) {
+    // 8 septets -> 7 octets
+    while (num_of_septets >= 8) {
+      // copy block first - packing can be made in place
+      for (i = 0; i < 8; i++) s[i] = septets[i] & 0x7F;
+      for (i = 0; i < 7; i++) {
+        p_dest[i] = (s[i] >> i) | (s[i+1] << (7-i));
+      }
+      p_dest += 7;
+      septets += 8;
+      num_of_septets -= 8;
+    }
+  }
+
+  // remaining septets through the accumulator
+  acc = 0;
+  bits = fill_bits;
+  while (num_of_septets) {
+    acc |= (uint16_t)(*septets++ & 0x7F) << bits;
+    bits += 7;
+    if (bits >= 8) {
+      *p_dest++ = (byte)acc;
+      acc >>= 8;
+      bits -= 8;
+    }
+    num_of_septets--;
+  }
+  if (bits) *p_dest++ = (byte)acc;
+
+  return (p_dest - dest);
+}
+
+/**********************************************************
+Method unpacks octets to GSM 7-bit characters(septets)
+
+septets:        pointer to the buffer where unpacked septets are placed
+                (must be different from src)
+src:            pointer to the packed octets
+num_of_septets: number of septets to be unpacked
+fill_bits:      number of fill bits before the first septet
+
+return:
+        number of unpacked septets
+**********************************************************/
+byte GSM::UnpackSeptets(byte *septets, byte *src, byte num_of_septets, byte fill_bits)
+{
+  byte num = num_of_septets;
+  byte i;
+  byte bits;
+  uint16_t acc;
+
+  if (fill_bits == 0) {
+    // 7 octets -> 8 septets
+    while (num_of_septets >= 8) {
+      septets[0] = src[0] & 0x7F;
+      for (i = 1; i < 7; i++) {
+        septets[i] = ((src[i] << i) | (src[i-1] >> (8-i))) & 0x7F;
+      }
+      septets[7] = src[6] >> 1;
+      src += 7;
+      septets += 8;
+      num_of_septets -= 8;
+    }
+    acc = 0;
+    bits = 0;
+  }
+  else {
+    // skip fill bits
+    acc = *src++ >> fill_bits;
+    bits = 8 - fill_bits;
+  }
+
+  // remaining septets through the accumulator
+  while (num_of_septets) {
+    if (bits < 7) {
+      acc |= (uint16_t)(*src++) << bits;
+      bits += 8;
+    }
+    *septets++ = acc & 0x7F;
+    acc >>= 7;
+    bits -= 7;
+    num_of_septets--;
+  }
+
+  return (num);
+}
+
+/**********************************************************
+Method converts text(ASCII/ISO 8859-1) to GSM 7-bit alphabet
+
+septets:      pointer to the buffer for the septets
+text:         pointer to the text
+text_len:     number of text characters
+max_septets:  size of the septets buffer
+
+Characters from the extension table(e.g. [ ] { } ^ ~ | \)
+take 2 septets, characters not present in the GSM alphabet
+are replaced by '?'
+
+return:
+        0     - text doesn't fit to the max_septets
+                (or text is empty)
+        >0    - number of septets
+**********************************************************/
+byte GSM::TextToGSM7(byte *septets, char *text, byte text_len, byte max_septets)
+{
+  byte num = 0;
+  byte c;
+  byte code;
+  byte i;
+
+  while (text_len--) {
+    c = (byte)*text++;
+    if (c < 0x80) {
+      code = pgm_read_byte(&ascii_to_gsm7[c]);
+    }
+    else {
+      // ISO 8859-1 national characters - rare so simply search the table
+      code = 0x3F;
+      for (i = 0; i < 128; i++) {
+        if (pgm_read_byte(&gsm7_to_latin1[i]) == c) {
+          code = i;
+          break;
+        }
+      }
+    }
+
+    if (code & 0x80) {
+      // extension table
+      if (num + 2 > max_septets) return (0);
+      septets[num++] = 0x1B;
+      septets[num++] = code & 0x7F;
+    }
+    else {
+      if (num + 1 > max_septets) return (0);
+      septets[num++] = code;
+    }
+  }
+  return (num);
+}
+
+/**********************************************************
+Method finds out how many text characters fit to the
+specified number of septets - characters from the extension
+table take 2 septets and are never split
+
+text:         pointer to the text
+text_len:     number of text characters
+max_septets:  available number of septets
+
+return:
+        number of text characters which fit
+**********************************************************/
+byte GSM::GSM7Fit(char *text, uint16_t text_len, byte max_septets)
+{
+  byte num = 0;
+  byte septets = 0;
+  byte c;
+  byte size;
+
+  while (text_len--) {
+    c = (byte)*text++;
+    size = 1;
+    if ((c < 0x80) && (pgm_read_byte(&ascii_to_gsm7[c]) & 0x80)) size = 2;
+    if (septets + size > max_septets) break;
+    septets += size;
+    num++;
+  }
+  return (num);
+}
+
+/**********************************************************
+Method converts GSM 7-bit alphabet to text(ISO 8859-1)
+
+text:           pointer to the text buffer
+                text may be the same as septets - conversion
+                can be made in place
+septets:        pointer to the septets
+num_of_septets: number of septets
+
+text is not finished by 0x00
+
+return:
+        number of text characters
+**********************************************************/
+byte GSM::GSM7ToText(char *text, byte *septets, byte num_of_septets)
+{
+  byte len = 0;
+  byte i;
+  byte j;
+  byte c;
+
+  for (i = 0; i < num_of_septets; i++) {
+    c = septets[i] & 0x7F;
+    if ((c == 0x1B) && (i + 1 < num_of_septets)) {
+      // extension table - unknown codes are displayed
+      // as characters from the default table
+      i++;
+      c = septets[i] & 0x7F;
+      text[len] = pgm_read_byte(&gsm7_to_latin1[c]);
+      for (j = 0; j < GSM7_EXT_NUM * 2; j += 2) {
+        if (pgm_read_byte(&gsm7_ext_to_latin1[j]) == c) {
+          text[len] = pgm_read_byte(&gsm7_ext_to_latin1[j+1]);
+          break;
+        }
+      }
+    }
+    else {
+      text[len] = pgm_read_byte(&gsm7_to_latin1[c]);
+    }
+    len++;
+  }
+  return (len);
+}
+
+/**********************************************************
+Method returns alphabet used by the data coding scheme(TP-DCS)
+
+return:
+        PDU_ALPHABET_7BIT - GSM 7-bit default alphabet
+        PDU_ALPHABET_8BIT - 8-bit data(also compressed and reserved coding)
+        PDU_ALPHABET_UCS2 - UCS2
+**********************************************************/
+byte GSM::PDUAlphabet(byte dcs)
+{
+  if ((dcs & 0x80) == 0x00) {
+    // general data coding group (also automatic deletion group)
+    if (dcs & 0x20) return (PDU_ALPHABET_8BIT); // compressed
+    switch ((dcs >> 2) & 0x03) {
+      case 0x01: return (PDU_ALPHABET_8BIT);
+      case 0x02: return (PDU_ALPHABET_UCS2);
+      default:   return (PDU_ALPHABET_7BIT);
+    }
+  }
+  if ((dcs & 0xF0) == 0xF0) {
+    // data coding/message class group
+    if (dcs & 0x04) return (PDU_ALPHABET_8BIT);
+    return (PDU_ALPHABET_7BIT);
+  }
+  if ((dcs & 0xF0) == 0xE0) return (PDU_ALPHABET_UCS2); // message waiting, UCS2
+  if ((dcs & 0xE0) == 0xC0) return (PDU_ALPHABET_7BIT); // message waiting
+  return (PDU_ALPHABET_8BIT); // reserved
+}
+
+/**********************************************************
+Method encodes phone number string to the address field
+(type of address followed by swapped semi-octets)
+
+p:          pointer where the type of address is placed
+number_str: phone number string, leading '+' means
+            international number, characters other then
+            digits, '*' and '#' are skipped
+
+return:
+        number of encoded digits
+**********************************************************/
+byte GSM::PDUEncodeAddress(byte *p, char *number_str)
+{
+  byte digits = 0;
+  byte c;
+
+  if (*number_str == '+') {
+    *p = PDU_TOA_INTERNATIONAL;
+    number_str++;
+  }
+  else *p = PDU_TOA_UNKNOWN;
+  p++;
+
+  while (((c = *number_str++) != 0) && (digits < PDU_NUMBER_LEN)) {
+    if ((c >= '0') && (c <= '9')) c -= '0';
+    else if (c == '*') c = 0x0A;
+    else if (c == '#') c = 0x0B;
+    else continue;
+
+    if (digits & 0x01) {
+      // second semi-octet = upper nibble
+      *p = (*p & 0x0F) | (c << 4);
+      p++;
+    }
+    else *p = 0xF0 | c; // 0xF as filler in case of odd number of digits
+    digits++;
+  }
+  return (digits);
+}
+
+/**********************************************************
+Method decodes address field to the phone number string
+
+number_str: pointer to the string - at least PDU_NUMBER_LEN+1 bytes
+toa:        type of address
+p:          pointer to the first semi-octet
+digits:     number of semi-octets
+**********************************************************/
+void GSM::PDUDecodeAddress(char *number_str, byte toa, byte *p, byte digits)
+{
+  byte i;
+  byte c;
+  byte len;
+
+  if ((toa & 0x70) == 0x50) {
+    // alphanumeric address - GSM 7-bit characters
+    len = (digits * 4) / 7;
+    if (len > PDU_NUMBER_LEN) len = PDU_NUMBER_LEN;
+    UnpackSeptets((byte *)number_str, p, len, 0);
+    len = GSM7ToText(number_str, (byte *)number_str, len);
+    number_str[len] = 0x00;
+    return;
+  }
+
+  if ((toa & 0x70) == 0x10) *number_str++ = '+'; // international number
+  if (digits > PDU_NUMBER_LEN - 1) digits = PDU_NUMBER_LEN - 1;
+  for (i = 0; i < digits; i++) {
+    if (i & 0x01) c = p[i >> 1] >> 4;
+    else c = p[i >> 1] & 0x0F;
+    if (c == 0x0F) break;
+    *number_str++ = pgm_read_byte(&bcd_digits[c]);
+  }
+  *number_str = 0x00;
+}
+
+/**********************************************************
+Method encodes SMS-SUBMIT PDU
+
+pdu:        pointer to the buffer for the PDU
+            at least PDU_BUF_LEN bytes
+sms:        pointer to the SMS structure, following items are used:
+            smsc, number, pid, dcs, udh, udh_len
+data:       pointer to the SMS data
+            - text for PDU_DCS_7BIT
+            - binary data for PDU_DCS_8BIT
+            - UCS2 big endian characters for PDU_DCS_UCS2
+data_len:   length of data in bytes
+flags:      PDU_FLAG_NONE
+            PDU_FLAG_SRR - status report is requested
+
+return:
+        0   - data don't fit to one SMS
+        >0  - length of the whole PDU including SMSC information
+              (length for the AT+CMGS is the returned value - (pdu[0]+1))
+**********************************************************/
+byte GSM::PDUEncodeSubmit(byte *pdu, pdu_sms_t *sms, byte *data, byte data_len, byte flags)
+{
+  byte *p = pdu;
+  byte *p_udl;
+  byte digits;
+  byte hdr_octets = 0;
+  byte hdr_septets;
+  byte num;
+
+  // SMSC information
+  if (sms->smsc[0]) {
+    digits = PDUEncodeAddress(p+1, sms->smsc);
+    *p = 1 + ((digits + 1) >> 1); // type of address + octets
+    p += 1 + *p;
+  }
+  else *p++ = 0x00;  // SMSC stored in the SIM is used
+
+  // first octet
+  *p = PDU_MTI_SUBMIT | PDU_FO_VPF_RELATIVE;
+  if (flags & PDU_FLAG_SRR) *p |= PDU_FO_SRR;
+  if (sms->udh_len) *p |= PDU_FO_UDHI;
+  p++;
+  *p++ = 0x00; // message reference is assigned by the module
+
+  // destination address
+  digits = PDUEncodeAddress(p+1, sms->number);
+  *p = digits;
+  p += 2 + ((digits + 1) >> 1);
+
+  *p++ = sms->pid;
+  *p++ = sms->dcs;
+  *p++ = PDU_VALIDITY_PERIOD;
+
+  // user data
+  p_udl = p++;
+  if (sms->udh_len) {
+    *p++ = sms->udh_len;
+    memcpy(p, sms->udh, sms->udh_len);
+    p += sms->udh_len;
+    hdr_octets = sms->udh_len + 1;
+  }
+
+  if (PDUAlphabet(sms->dcs) == PDU_ALPHABET_7BIT) {
+    // header takes whole septets so fill bits are inserted behind it
+    hdr_septets = ((hdr_octets << 3) + 6) / 7;
+    // septets are placed directly where they will be packed
+    num = TextToGSM7(p, (char *)data, data_len, PDU_UD_MAX_SEPTETS - hdr_septets);
+    if ((num == 0) && data_len) return (0);
+    *p_udl = hdr_septets + num;
+    p += PackSeptets(p, p, num, hdr_septets * 7 - (hdr_octets << 3));
+  }
+  else {
+    if (hdr_octets + data_len > PDU_UD_MAX_OCTETS) return (0);
+    *p_udl = hdr_octets + data_len;
+    memcpy(p, data, data_len);
+    p += data_len;
+  }
+
+  return (p - pdu);
+}
+
+/**********************************************************
+Method decodes SMS-DELIVER or SMS-SUBMIT PDU
+
+pdu:          pointer to the binary PDU(including SMSC information)
+pdu_len:      length of the PDU
+sms:          pointer to the SMS structure which is filled
+data:         pointer to the buffer for SMS data
+              - 7-bit data are converted to the text
+              - 8-bit and UCS2 data are copied as they are
+              data are always finished by 0x00
+max_data_len: size of the data buffer including 0x00 termination,
+              longer data are cut
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - PDU is not valid or not supported
+
+        OK ret val:
+        -----------
+        PDU_MTI_DELIVER  - received SMS was decoded
+        PDU_MTI_SUBMIT   - SMS stored for sending was decoded
+**********************************************************/
+char GSM::PDUDecode(byte *pdu, byte pdu_len, pdu_sms_t *sms, byte *data, byte max_data_len)
+{
+  byte *p = pdu;
+  byte *p_end = pdu + pdu_len;
+  byte fo;
+  byte len;
+  byte udl;
+  byte hdr_octets = 0;
+  byte hdr_septets;
+  byte num;
+
+  data[0] = 0x00;
+  sms->data_len = 0;
+  sms->udh_len = 0;
+  sms->mr = 0;
+  sms->year = sms->month = sms->day = 0;
+  sms->hour = sms->minute = sms->second = 0;
+  sms->tz = 0;
+
+  if (pdu_len < 2) return (-1);
+
+  // SMSC information
+  len = *p++;
+  sms->smsc[0] = 0x00;
+  if (len) {
+    PDUDecodeAddress(sms->smsc, p[0], p+1, (len - 1) << 1);
+    p += len;
+  }
+  if (p + 4 > p_end) return (-1);
+
+  fo = *p++;
+  sms->mti = fo & 0x03;
+  if (sms->mti == PDU_MTI_SUBMIT) sms->mr = *p++;
+  else if (sms->mti != PDU_MTI_DELIVER) return (-1);
+
+  // originating or destination address
+  len = *p++;
+  PDUDecodeAddress(sms->number, p[0], p+1, len);
+  p += 1 + ((len + 1) >> 1);
+  if (p + 3 > p_end) return (-1);
+
+  sms->pid = *p++;
+  sms->dcs = *p++;
+  if (sms->mti == PDU_MTI_DELIVER) {
+    // service centre time stamp - swapped semi-octets
+    if (p + 7 > p_end) return (-1);
+    sms->year   = (p[0] & 0x0F) * 10 + (p[0] >> 4);
+    sms->month  = (p[1] & 0x0F) * 10 + (p[1] >> 4);
+    sms->day    = (p[2] & 0x0F) * 10 + (p[2] >> 4);
+    sms->hour   = (p[3] & 0x0F) * 10 + (p[3] >> 4);
+    sms->minute = (p[4] & 0x0F) * 10 + (p[4] >> 4);
+    sms->second = (p[5] & 0x0F) * 10 + (p[5] >> 4);
+    // bit 3 is the sign of the time zone
+    sms->tz     = (p[6] & 0x07) * 10 + (p[6] >> 4);
+    if (p[6] & 0x08) sms->tz = -sms->tz;
+    p += 7;
+  }
+  else {
+    // validity period
+    if ((fo & 0x18) == PDU_FO_VPF_RELATIVE) p++;
+    else if (fo & 0x18) p += 7;
+  }
+  if (p >= p_end) return (-1);
+
+  udl = *p++;
+  if (fo & PDU_FO_UDHI) {
+    if (p >= p_end) return (-1);
+    hdr_octets = p[0] + 1;
+    sms->udh_len = (p[0] > PDU_UDH_MAX_LEN) ? PDU_UDH_MAX_LEN : p[0];
+    memcpy(sms->udh, p+1, sms->udh_len);
+  }
+
+  if (PDUAlphabet(sms->dcs) == PDU_ALPHABET_7BIT) {
+    hdr_septets = ((hdr_octets << 3) + 6) / 7;
+    if ((udl < hdr_septets) || (p + ((udl * 7 + 7) >> 3) > p_end)) return (-1);
+    num = udl - hdr_septets;
+    if (num > max_data_len - 1) num = max_data_len - 1;
+    UnpackSeptets(data, p + hdr_octets, num, hdr_septets * 7 - (hdr_octets << 3));
+    num = GSM7ToText((char *)data, data, num);
+  }
+  else {
+    if ((udl < hdr_octets) || (p + udl > p_end)) return (-1);
+    num = udl - hdr_octets;
+    if (num > max_data_len - 1) num = max_data_len - 1;
+    memcpy(data, p + hdr_octets, num);
+  }
+  data[num] = 0x00;
+  sms->data_len = num;
+
+  return (sms->mti);
+}
+
+/**********************************************************
+Method sends data as hexadecimal string to the GSM module
+**********************************************************/
+void GSM::SendHex(byte *data, byte len)
+{
+  while (len--) WriteHexByte(*data++);
+}
+
+/**********************************************************
+Method waits for the '>' prompt
+- the communication buffer is not used so it can hold
+  data which are going to be sent
+
+return:
+      RX_FINISHED_STR_RECV  prompt was received
+      RX_TMOUT_ERR          prompt was not received in timeout
+**********************************************************/
+byte GSM::WaitPrompt(uint16_t start_comm_tmout)
+{
+  unsigned long prev_time = millis();
+
+  while ((unsigned long)(millis() - prev_time) < start_comm_tmout) {
+    if (outSerial.available()) {
+      if (outSerial.read() == '>') return (RX_FINISHED_STR_RECV);
+    }
+  }
+  return (RX_TMOUT_ERR);
+}
+
+/**********************************************************
+Method receives response with PDU, e.g.:
+<CR><LF>+CMGR: <stat>,[<alpha>],<length><CR><LF><pdu><CR><LF>
+<CR><LF>OK<CR><LF>
+
+The header line is stored in the comm_buf as a string,
+the hexadecimal PDU string is converted to binary data
+on the fly and stored just behind the header string, so
+the PDU takes only half of the space in the comm. buffer.
+Reception is finished immediately after final "OK"
+is received.
+
+header:           expected header string, e.g. "+CMGR:"
+start_comm_tmout: maximum waiting time for the first response
+                  character (in msec.)
+p_pdu:            pointer to the binary PDU in the comm_buf is placed here
+pdu_len:          length of the binary PDU is placed here
+
+return:
+      RX_FINISHED_STR_RECV,     header and PDU received
+      RX_FINISHED_STR_NOT_RECV  finished, but header was not received
+      RX_TMOUT_ERR              no character received
+**********************************************************/
+byte GSM::RcvPDU(char const *header, uint16_t start_comm_tmout, byte **p_pdu, byte *pdu_len)
+{
+  byte ret_val = RX_TMOUT_ERR;
+  byte state = PDU_RX_HEADER;
+  byte *p_wr = NULL;
+  byte num_of_nibbles = 0;
+  byte value = 0;
+  byte last_char = 0;
+  byte c;
+  char nibble;
+  uint16_t tmout = start_comm_tmout;
+  unsigned long prev_time = millis();
+
+  comm_buf_len = 0;
+  comm_buf[0] = 0x00;
+  *p_pdu = NULL;
+  *pdu_len = 0;
+
+  while ((unsigned long)(millis() - prev_time) < tmout) {
+    if (!outSerial.available()) continue;
+    c = outSerial.read();
+    prev_time = millis();
+    tmout = MAX_MID_INTERCHAR_TMOUT;
+
+    if (state == PDU_RX_HEADER) {
+      ret_val = RX_FINISHED_STR_NOT_RECV;
+      if (comm_buf_len < COMM_BUF_LEN) {
+        comm_buf[comm_buf_len++] = c;
+        comm_buf[comm_buf_len] = 0x00;
+      }
+      if (c == 0x0a) {
+        if (strstr((char *)comm_buf, header) != NULL) {
+          // header line is complete => PDU follows
+          // binary PDU is placed behind 0x00 of the header string
+          p_wr = &comm_buf[comm_buf_len + 1];
+          *p_pdu = p_wr;
+          state = PDU_RX_HEX;
+          ret_val = RX_FINISHED_STR_RECV;
+        }
+        else if ((strstr((char *)comm_buf, "OK\r\n") != NULL)
+                 || (strstr((char *)comm_buf, "ERROR") != NULL)) {
+          // no PDU in the response
+          break;
+        }
+      }
+    }
+    else if (state == PDU_RX_HEX) {
+      nibble = HexNibble(c);
+      if (nibble < 0) {
+        // <CR><LF> finishes the PDU string
+        if (num_of_nibbles) state = PDU_RX_TRAILER;
+        continue;
+      }
+      value = (value << 4) | nibble;
+      num_of_nibbles++;
+      if (((num_of_nibbles & 0x01) == 0) && (p_wr < &comm_buf[COMM_BUF_LEN])) {
+        *p_wr++ = value;
+      }
+    }
+    else {
+      // wait only for the final OK
+      if ((last_char == 'O') && (c == 'K')) break;
+      last_char = c;
+    }
+  }
+
+  if (*p_pdu != NULL) *pdu_len = p_wr - *p_pdu;
+  return (ret_val);
+}
+
+/**********************************************************
+Method sends SMS in the PDU mode
+
+sms:      pointer to the SMS structure, following items are used:
+          smsc   - "" means SMSC stored in the SIM
+          number - destination phone number
+          pid    - protocol identifier, standard value is 0
+          dcs    - PDU_DCS_7BIT, PDU_DCS_8BIT or PDU_DCS_UCS2
+          udh, udh_len - user data header, udh_len = 0 means no header
+          mr     - message reference assigned by the SMSC is placed here
+data:     pointer to the SMS data(text or binary)
+data_len: length of the SMS data
+flags:    PDU_FLAG_NONE or PDU_FLAG_SRR - status report is requested,
+          the SMS can be tracked by TrackSMS(sms->mr) then
+          (version without flags sends PDU_FLAG_NONE)
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -3 - data don't fit to one SMS
+
+        OK ret val:
+        -----------
+        0 - SMS was not sent
+        1 - SMS was sent
+
+
+an example of usage:
+        GSM gsm;
+        pdu_sms_t sms;
+        byte telemetry[4] = {0x01, 0x02, 0x03, 0x04};
+
+        memset(&sms, 0, sizeof(sms));
+        strcpy(sms.number, "+XXXYYYYYYYYY");
+        sms.dcs = PDU_DCS_8BIT;
+        gsm.SendSMSPDU(&sms, telemetry, 4);
+**********************************************************/
+char GSM::SendSMSPDU(pdu_sms_t *sms, byte *data, byte data_len)
+{
+  return (SendSMSPDU(sms, data, data_len, PDU_FLAG_NONE));
+}
+
+char GSM::SendSMSPDU(pdu_sms_t *sms, byte *data, byte data_len, byte flags)
+{
+  char ret_val = -1;
+  byte i;
+  byte pdu_len;
+  char *p_char;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = 0; // still not send
+  SelectSMSMode(SMS_MODE_PDU);
+
+  // try to send SMS 3 times in case there is some problem
+  for (i = 0; i < 3; i++) {
+    // PDU is prepared in the comm. buffer - it must be prepared
+    // for each attempt because comm. buffer is overwritten by the response
+    pdu_len = PDUEncodeSubmit(comm_buf, sms, data, data_len, flags);
+    if (pdu_len == 0) {
+      ret_val = -3;
+      break;
+    }
+
+    // send  AT+CMGS=<length of TPDU>
+    outSerial.print(F("AT+CMGS="));
+    outSerial.print((int)(pdu_len - comm_buf[0] - 1));
+    outSerial.print(F("\r"));
+
+    if (RX_FINISHED_STR_RECV == WaitPrompt(START_LONG_COMM_TMOUT)) {
+      // send PDU
+      SendHex(comm_buf, pdu_len);
+
+#ifdef DEBUG_SMS_ENABLED
+      // SMS will not be sent = we will not pay => good for debugging
+      outSerial.write(27);
+      if (RX_FINISHED_STR_RECV == WaitResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK")) {
+#else
+      outSerial.write(26);
+      if (RX_FINISHED_STR_RECV == WaitResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CMGS")) {
+#endif
+        // SMS was send correctly
+        // response: +CMGS: <mr>
+        p_char = strchr((char *)comm_buf, ':');
+        if (p_char != NULL) sms->mr = atoi(p_char + 1);
+        ret_val = 1;
+        break;
+      }
+      else continue;
+    }
+    else {
+      // try again
+      continue;
+    }
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads SMS in the PDU mode from specified memory(SIM) position
+SMS is parsed from the binary PDU, so it doesn't depend on the
+text mode formatting and also 8-bit(binary) SMS can be received
+
+position:     SMS position <1..20>
+sms:          pointer to the SMS structure which is filled
+data:         pointer to the buffer for the SMS data
+              7-bit SMS is converted to the text
+              8-bit and UCS2 SMS are copied as they are
+              data are finished by 0x00, length is in sms->data_len
+max_data_len: size of the data buffer including 0x00 termination
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - specified position must be > 0
+
+        OK ret val:
+        -----------
+        GETSMS_NO_SMS       - no SMS was not found at the specified position
+        GETSMS_UNREAD_SMS   - new SMS was found at the specified position
+        GETSMS_READ_SMS     - already read SMS was found at the specified position
+        GETSMS_OTHER_SMS    - other type of SMS was found
+
+
+an example of usage:
+        GSM gsm;
+        pdu_sms_t sms;
+        byte data[141];
+
+        if (GETSMS_UNREAD_SMS == gsm.GetSMSPDU(1, &sms, data, sizeof(data))) {
+          // sms.number - sender, sms.data_len bytes in the data
+        }
+**********************************************************/
+char GSM::GetSMSPDU(byte position, pdu_sms_t *sms, byte *data, byte max_data_len)
+{
+  char ret_val = -1;
+  char *p_char;
+  byte *p_pdu;
+  byte pdu_len;
+
+  if (position == 0) return (-3);
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = GETSMS_NO_SMS; // still no SMS
+  data[0] = 0x00;
+  sms->data_len = 0;
+  SelectSMSMode(SMS_MODE_PDU);
+
+  //send "AT+CMGR=X" - where X = position
+  outSerial.print(F("AT+CMGR="));
+  outSerial.print((int)position);
+  outSerial.print(F("\r"));
+
+  // 5000 msec. for initial comm tmout
+  switch (RcvPDU("+CMGR:", START_XLONG_COMM_TMOUT, &p_pdu, &pdu_len)) {
+    case RX_TMOUT_ERR:
+      // response was not received in specific time
+      ret_val = -2;
+      break;
+
+    case RX_FINISHED_STR_RECV:
+      // +CMGR: <stat>,[<alpha>],<length>
+      // <stat>: 0 - received unread, 1 - received read,
+      //         2 - stored unsent, 3 - stored sent
+      p_char = strstr((char *)comm_buf, "+CMGR:");
+      switch (atoi(p_char + 6)) {
+        case 0:  ret_val = GETSMS_UNREAD_SMS; break;
+        case 1:  ret_val = GETSMS_READ_SMS;   break;
+        default: ret_val = GETSMS_OTHER_SMS;  break;
+      }
+      if (PDUDecode(p_pdu, pdu_len, sms, data, max_data_len) < 0) {
+        // PDU is not complete or not supported
+        ret_val = GETSMS_OTHER_SMS;
+      }
+      break;
+
+    default:
+      // only OK or ERROR => there is NO SMS
+      ret_val = GETSMS_NO_SMS;
+      break;
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
@@ -0,0 +1,121 @@
+/*
+	GSM_PDU.h - SMS PDU mode library for the Advanced GPRS Shield - SiGAlabs
+	www.sigalabs.com
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __GSM_PDU
+#define __GSM_PDU
+
+#if defined(ARDUINO) && ARDUINO >= 100
+  #include "Arduino.h"
+  #else
+  #include "WProgram.h"
+#endif
+
+#define PDU_LIB_VERSION 102 // library version X.YY (e.g. 1.00)
+/*
+    Version
+    --------------------------------------------------------------------------
+    100       Initial version
+              SMS-SUBMIT encoding, SMS-DELIVER/SMS-SUBMIT decoding,
+              GSM 7-bit default alphabet and 8-bit data coding
+    --------------------------------------------------------------------------
+    101       SendSMSPDU() with flags - status report can be requested
+    --------------------------------------------------------------------------
+    102       Hex strings are converted by the common methods of the AT class
+              (HexNibble(), HexToByte(), WriteHexByte())
+    --------------------------------------------------------------------------
+*/
+
+// max. length of the phone number string (excluding 0x00 termination)
+#ifndef PDU_NUMBER_LEN
+	#define PDU_NUMBER_LEN      20
+#endif // end of ifndef PDU_NUMBER_LEN
+
+// max. length of the user data header which is kept in the pdu_sms_t
+#ifndef PDU_UDH_MAX_LEN
+	#define PDU_UDH_MAX_LEN     12
+#endif // end of ifndef PDU_UDH_MAX_LEN
+
+// min. size of the buffer for the PDUEncodeSubmit()
+// (SMSC + header + user data in septets before packing)
+#define PDU_BUF_LEN         190
+
+// max. length of the user data in octets and in septets
+#define PDU_UD_MAX_OCTETS   140
+#define PDU_UD_MAX_SEPTETS  160
+
+// relative validity period used for SMS-SUBMIT, 0xAA = 4 days
+#ifndef PDU_VALIDITY_PERIOD
+	#define PDU_VALIDITY_PERIOD 0xAA
+#endif // end of ifndef PDU_VALIDITY_PERIOD
+
+// data coding scheme (TP-DCS) - general data coding group, no message class
+#define PDU_DCS_7BIT        0x00
+#define PDU_DCS_8BIT        0x04
+#define PDU_DCS_UCS2        0x08
+
+// alphabets returned by the PDUAlphabet() method
+enum pdu_alphabet_enum
+{
+  PDU_ALPHABET_7BIT = 0,
+  PDU_ALPHABET_8BIT,
+  PDU_ALPHABET_UCS2,
+
+  PDU_ALPHABET_LAST_ITEM
+};
+
+// message type indicator (TP-MTI) - bits 0,1 of the first octet
+#define PDU_MTI_DELIVER        0x00
+#define PDU_MTI_SUBMIT         0x01
+#define PDU_MTI_STATUS_REPORT  0x02
+
+// bits of the first octet
+#define PDU_FO_VPF_RELATIVE    0x10  // validity period in relative format
+#define PDU_FO_SRR             0x20  // status report request
+#define PDU_FO_UDHI            0x40  // user data header is present
+
+// type of address
+#define PDU_TOA_INTERNATIONAL  0x91
+#define PDU_TOA_UNKNOWN        0x81
+#define PDU_TOA_ALPHANUMERIC   0xD0
+
+// flags for the PDUEncodeSubmit() method
+#define PDU_FLAG_NONE          0x00
+#define PDU_FLAG_SRR           0x01  // request status report
+
+// SMS in PDU form - used for sending as well as for receiving
+typedef struct
+{
+  char smsc[PDU_NUMBER_LEN+1];    // SMS centre number, empty string = SMSC stored in the SIM
+  char number[PDU_NUMBER_LEN+1];  // originating(received SMS) or destination(sent SMS) address
+  byte mti;                       // message type indicator PDU_MTI_...
+  byte mr;                        // message reference(sent SMS)
+  byte pid;                       // protocol identifier
+  byte dcs;                       // data coding scheme PDU_DCS_...
+  byte year;                      // service centre time stamp(received SMS)
+  byte month;
+  byte day;
+  byte hour;
+  byte minute;
+  byte second;
+  signed char tz;                 // time zone in quarters of an hour
+  byte udh_len;                   // length of the user data header, 0 = no header
+  byte udh[PDU_UDH_MAX_LEN];      // user data header without the UDHL octet
+  byte data_len;                  // number of characters/octets in the data buffer
+} pdu_sms_t;
+
+
+#endif
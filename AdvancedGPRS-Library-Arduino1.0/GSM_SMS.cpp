@@ -0,0 +1,1364 @@
+/*
+	GSM_SMS.cpp - SMS library for the Advanced GPRS Shield - SiGAlabs
+	www.sigalabs.com
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GSM_SMS.h"
+#include "GSM.h"
+
+#include <avr/eeprom.h>
+
+extern "C" {
+  #include <string.h>
+}
+
+
+// status byte values stored in the EEPROM
+// other values(also erased EEPROM 0xFF) mean free slot
+#define SMSQ_EE_PENDING   0xA1
+#define SMSQ_EE_SENT      0xA2
+#define SMSQ_EE_FAILED    0xA3
+
+#define SMSQ_SLOT_ADDR(slot) (SMS_QUEUE_EEPROM_ADDR + (int)(slot) * SMSQ_SLOT_SIZE)
+
+
+/**********************************************************
+Method returns SMS library version
+
+return val: 100 means library version 1.00
+            101 means library version 1.01
+**********************************************************/
+int GSM::SMSLibVer(void)
+{
+  return (SMS_LIB_VERSION);
+}
+
+
+/**********************************************************
+Method returns length of the data which fit to one part
+of the concatenated SMS
+
+alphabet: PDU_ALPHABET_...
+data:     pointer to the remaining data
+data_len: length of the remaining data
+
+return:
+        number of data bytes(characters) for the part
+**********************************************************/
+byte GSM::ConcatPartLen(byte alphabet, byte *data, uint16_t data_len)
+{
+  byte len;
+
+  if (alphabet == PDU_ALPHABET_7BIT) {
+    return (GSM7Fit((char *)data, data_len, CONCAT_PART_SEPTETS));
+  }
+
+  if (data_len > CONCAT_PART_OCTETS) len = CONCAT_PART_OCTETS;
+  else len = data_len;
+  if ((alphabet == PDU_ALPHABET_UCS2) && (len < data_len)) {
+    // whole UCS2 characters, surrogate pair is not split
+    len &= 0xFE;
+    if ((data[len-2] & 0xFC) == 0xD8) len -= 2;
+  }
+  return (len);
+}
+
+/**********************************************************
+Method sends long SMS - SMS which doesn't fit to one
+message is split to the parts with the concatenation user
+data header (8-bit reference) and every part is sent
+in the PDU mode
+
+Short SMS is sent as one standard SMS without header.
+
+sms:      pointer to the SMS structure, see SendSMSPDU()
+          udh_len must be 0 - header is made by this method
+data:     pointer to the SMS data(text or binary)
+data_len: length of the SMS data
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -3 - data need more then 255 parts
+
+        OK ret val:
+        -----------
+        0 - SMS was not sent(some part was not sent)
+        1 - SMS was sent(all parts)
+
+
+an example of usage:
+        GSM gsm;
+        gsm.SendLongSMS("00XXXYYYYYYYYY", long_report);
+**********************************************************/
+char GSM::SendLongSMS(pdu_sms_t *sms, byte *data, uint16_t data_len)
+{
+  char ret_val = -1;
+  byte alphabet;
+  byte total;
+  byte seq;
+  byte len;
+  uint16_t pos;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+
+  alphabet = PDUAlphabet(sms->dcs);
+  sms->udh_len = 0;
+
+  // is it possible to send it as one standard SMS?
+  if (alphabet == PDU_ALPHABET_7BIT) {
+    if (GSM7Fit((char *)data, data_len, PDU_UD_MAX_SEPTETS) == data_len) {
+      return (SendSMSPDU(sms, data, data_len));
+    }
+  }
+  else if (data_len <= PDU_UD_MAX_OCTETS) {
+    return (SendSMSPDU(sms, data, data_len));
+  }
+
+  // find out number of parts
+  total = 0;
+  pos = 0;
+  while (pos < data_len) {
+    if (total == 255) return (-3);
+    pos += ConcatPartLen(alphabet, data + pos, data_len - pos);
+    total++;
+  }
+
+  // concatenation header: IEI, IEL, reference, total, sequence
+  concat_ref++;
+  sms->udh[0] = UDH_IEI_CONCAT_8BIT;
+  sms->udh[1] = 3;
+  sms->udh[2] = concat_ref;
+  sms->udh[3] = total;
+  sms->udh_len = 5;
+
+  pos = 0;
+  for (seq = 1; seq <= total; seq++) {
+    len = ConcatPartLen(alphabet, data + pos, data_len - pos);
+    sms->udh[4] = seq;
+    ret_val = SendSMSPDU(sms, data + pos, len);
+    if (ret_val != 1) break;
+    pos += len;
+  }
+
+  sms->udh_len = 0;
+  return (ret_val);
+}
+
+/**********************************************************
+Method sends long text SMS
+- the same as SendLongSMS() above but only for the text
+
+number_str:   pointer to the phone number string
+message_str:  pointer to the SMS text string
+**********************************************************/
+char GSM::SendLongSMS(char *number_str, char *message_str)
+{
+  pdu_sms_t sms;
+
+  memset(&sms, 0, sizeof(sms));
+  strncpy(sms.number, number_str, PDU_NUMBER_LEN);
+  sms.dcs = PDU_DCS_7BIT;
+  return (SendLongSMS(&sms, (byte *)message_str, strlen(message_str)));
+}
+
+/**********************************************************
+Method initializes reassembly table for the received
+concatenated SMS
+
+Table is allocated by the user, so the memory is used only
+in case the reassembly is required and its size is fixed:
+one item for every concatenated SMS which can be received
+at the same time.
+When the table is full the oldest incomplete SMS is evicted.
+NULL table or 0 items means there is no table, AddConcatPart()
+returns CONCAT_ERR_NO_TABLE for the parts then.
+
+table:        pointer to the table
+num_of_slots: number of items in the table
+
+
+an example of usage:
+        GSM gsm;
+        concat_slot_t concat_table[2];
+
+        gsm.InitConcatSMS(concat_table, 2);
+**********************************************************/
+void GSM::InitConcatSMS(concat_slot_t *table, byte num_of_slots)
+{
+  byte i;
+
+  concat_table = table;
+  concat_slots = num_of_slots;
+  if (concat_table == NULL || concat_slots == 0) {
+    concat_table = NULL;
+    concat_slots = 0;
+    return;
+  }
+  for (i = 0; i < num_of_slots; i++) {
+    table[i].total = 0; // item is free
+  }
+}
+
+/**********************************************************
+Method discards incomplete concatenated SMS whose parts
+have not been received for the CONCAT_TMOUT
+- it is called automatically by the AddConcatPart()
+**********************************************************/
+void GSM::PurgeConcatSMS(void)
+{
+  byte i;
+
+  for (i = 0; i < concat_slots; i++) {
+    if (concat_table[i].total
+        && ((unsigned long)(millis() - concat_table[i].last_time) >= CONCAT_TMOUT)) {
+      concat_table[i].total = 0;
+    }
+  }
+}
+
+/**********************************************************
+Method adds received SMS to the reassembly table
+
+sms:          pointer to the received SMS(see GetSMSPDU())
+data:         pointer to the received SMS data
+msg:          pointer to the output buffer for the complete SMS
+max_msg_len:  size of the output buffer including 0x00 termination
+msg_len:      length of the complete SMS is placed here
+
+return:
+        ERROR ret. val:
+        ---------------
+        CONCAT_ERR_BUFFER   - max_msg_len is 0, there is no place even
+                              for the 0x00 termination
+        CONCAT_ERR_NO_TABLE - table was not initialized by InitConcatSMS()
+        CONCAT_ERR_PART     - part was not stored: it has more then
+                              CONCAT_MAX_PARTS parts or part is too long
+
+        OK ret val:
+        -----------
+        CONCAT_PART_STORED  - part was stored, SMS is not complete yet
+        CONCAT_COMPLETE     - last part was received, complete SMS is in the msg
+        CONCAT_SINGLE       - SMS is not a part of concatenated SMS,
+                              it is copied to the msg
+
+
+an example of usage:
+        position = gsm.IsSMSPresent(SMS_UNREAD);
+        if (position > 0) {
+          gsm.GetSMSPDU(position, &sms, data, sizeof(data));
+          gsm.DeleteSMS(position);
+          if (gsm.AddConcatPart(&sms, data, msg, sizeof(msg), &msg_len) >= CONCAT_COMPLETE) {
+            // whole SMS is in the msg
+          }
+        }
+**********************************************************/
+char GSM::AddConcatPart(pdu_sms_t *sms, byte *data,
+                        byte *msg, uint16_t max_msg_len, uint16_t *msg_len)
+{
+  concat_slot_t *slot = NULL;
+  concat_slot_t *free_slot = NULL;
+  concat_slot_t *oldest_slot = NULL;
+  uint16_t ref = 0;
+  uint16_t len;
+  byte total = 0;
+  byte seq = 0;
+  byte i;
+  byte n;
+
+  *msg_len = 0;
+  if (max_msg_len == 0) return (CONCAT_ERR_BUFFER);
+
+  // find concatenation information element in the header
+  i = 0;
+  while (i + 2 <= sms->udh_len) {
+    n = sms->udh[i+1];
+    if (i + 2 + n > sms->udh_len) break;
+    if ((sms->udh[i] == UDH_IEI_CONCAT_8BIT) && (n == 3)) {
+      ref = sms->udh[i+2];
+      total = sms->udh[i+3];
+      seq = sms->udh[i+4];
+      break;
+    }
+    if ((sms->udh[i] == UDH_IEI_CONCAT_16BIT) && (n == 4)) {
+      ref = ((uint16_t)sms->udh[i+2] << 8) | sms->udh[i+3];
+      total = sms->udh[i+4];
+      seq = sms->udh[i+5];
+      break;
+    }
+    i += 2 + n;
+  }
+
+  if (total <= 1) {
+    // standard SMS
+    len = sms->data_len;
+    if (len > max_msg_len - 1) len = max_msg_len - 1;
+    memcpy(msg, data, len);
+    msg[len] = 0x00;
+    *msg_len = len;
+    return (CONCAT_SINGLE);
+  }
+
+  if (concat_table == NULL) return (CONCAT_ERR_NO_TABLE);
+  if ((seq == 0) || (seq > total) || (total > CONCAT_MAX_PARTS)
+      || (sms->data_len > CONCAT_PART_LEN)) return (CONCAT_ERR_PART);
+
+  PurgeConcatSMS();
+
+  // SMS is identified by the sender, reference and number of parts
+  for (i = 0; i < concat_slots; i++) {
+    if (concat_table[i].total == 0) {
+      if (free_slot == NULL) free_slot = &concat_table[i];
+      continue;
+    }
+    if ((concat_table[i].ref == ref) && (concat_table[i].total == total)
+        && (strcmp(concat_table[i].number, sms->number) == 0)) {
+      slot = &concat_table[i];
+      break;
+    }
+    if ((oldest_slot == NULL)
+        || ((long)(concat_table[i].last_time - oldest_slot->last_time) < 0)) {
+      oldest_slot = &concat_table[i];
+    }
+  }
+
+  if (slot == NULL) {
+    // first part of the new SMS - use free item or evict the oldest one
+    if (free_slot != NULL) slot = free_slot;
+    else slot = oldest_slot;
+    strcpy(slot->number, sms->number);
+    slot->ref = ref;
+    slot->total = total;
+    slot->received = 0;
+  }
+
+  memcpy(slot->part[seq-1], data, sms->data_len);
+  slot->part_len[seq-1] = sms->data_len;
+  slot->received |= 1 << (seq-1);
+  slot->last_time = millis();
+
+  if (slot->received != (byte)((1 << total) - 1)) return (CONCAT_PART_STORED);
+
+  // all parts received => copy them to the output buffer
+  len = 0;
+  for (i = 0; i < total; i++) {
+    n = slot->part_len[i];
+    if (len + n > max_msg_len - 1) n = max_msg_len - 1 - len;
+    memcpy(msg + len, slot->part[i], n);
+    len += n;
+  }
+  msg[len] = 0x00;
+  *msg_len = len;
+  slot->total = 0; // item is free again
+
+  return (CONCAT_COMPLETE);
+}
+
+/**********************************************************
+Method sends the same SMS to more recipients
+The SMS text is written to the SMS storage only once(AT+CMGW)
+and then the stored SMS is sent to every recipient(AT+CMSS)
+so the text is not transferred again for each recipient.
+Next AT+CMSS is sent immediately after the module has
+finished the previous one, stored SMS is deleted at the end.
+
+numbers:        array of pointers to the phone number strings
+num_of_numbers: number of recipients
+message_str:    pointer to the SMS text string
+
+return: 
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - SMS was not stored to the SMS storage
+
+        OK ret val:
+        -----------
+        0..num_of_numbers - number of recipients the SMS was sent to
+                            (up to 255, so the value is int)
+
+
+an example of usage:
+        GSM gsm;
+        char *numbers[] = {"00XXXYYYYYYYYY", "00XXXZZZZZZZZZ"};
+
+        gsm.SendSMSBroadcast(numbers, 2, "Alarm: door open");
+**********************************************************/
+int GSM::SendSMSBroadcast(char **numbers, byte num_of_numbers, char *message_str)
+{
+  int ret_val = -1;
+  byte index = 0;
+  byte i;
+  char *p_char;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = -2; // not stored yet
+  SelectSMSMode(SMS_MODE_TEXT);
+
+  // store SMS: AT+CMGW<CR> > text<Ctrl-Z>
+  // response: +CMGW: <index>
+  outSerial.print(F("AT+CMGW\r"));
+  if (RX_FINISHED_STR_RECV == WaitPrompt(START_LONG_COMM_TMOUT)) {
+    outSerial.print(message_str);
+    outSerial.write(26);
+    if (RX_FINISHED_STR_RECV == WaitFinalResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CMGW:")) {
+      p_char = strchr((char *)comm_buf, ':');
+      if (p_char != NULL) index = atoi(p_char + 1);
+    }
+  }
+
+  if (index) {
+    ret_val = 0;
+    for (i = 0; i < num_of_numbers; i++) {
+#ifdef DEBUG_SMS_ENABLED
+      // SMS will not be sent = we will not pay => good for debugging
+      ret_val++;
+#else
+      // send  AT+CMSS=<index>,"number_str"
+      // response: +CMSS: <mr>
+      outSerial.print(F("AT+CMSS="));
+      outSerial.print((int)index);
+      outSerial.print(F(",\""));
+      outSerial.print(numbers[i]);
+      outSerial.print(F("\"\r"));
+      if (RX_FINISHED_STR_RECV == WaitFinalResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CMSS:")) {
+        ret_val++;
+      }
+#endif
+    }
+
+    // stored SMS is not necessary any more
+    outSerial.print(F("AT+CMGD="));
+    outSerial.print((int)index);
+    outSerial.print(F("\r"));
+    WaitFinalResp(START_XLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK");
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method initializes queue for the SMS burst
+Queue is allocated by the user, one item for every SMS
+which can wait for sending.
+
+queue:      pointer to the queue
+queue_len:  number of items in the queue
+
+
+an example of usage:
+        GSM gsm;
+        sms_out_t sms_queue[3];
+
+        gsm.InitSMSBurst(sms_queue, 3);
+**********************************************************/
+void GSM::InitSMSBurst(sms_out_t *queue, byte queue_len)
+{
+  burst_queue = queue;
+  burst_queue_len = queue_len;
+  burst_head = 0;
+  burst_count = 0;
+}
+
+/**********************************************************
+Method puts SMS to the burst queue
+SMS is copied so the strings can be reused immediately,
+SMS are sent later by the FlushSMSBurst()
+
+number_str:   pointer to the phone number string
+message_str:  pointer to the SMS text string
+              (longer text is cut to SMS_BURST_TEXT_LEN)
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - queue is full or not initialized
+
+        OK ret val:
+        -----------
+        1..  number of SMS in the queue
+**********************************************************/
+char GSM::QueueSMS(char *number_str, char *message_str)
+{
+  sms_out_t *item;
+
+  if (burst_count >= burst_queue_len) return (-1);
+
+  item = &burst_queue[(burst_head + burst_count) % burst_queue_len];
+  strncpy(item->number, number_str, PDU_NUMBER_LEN);
+  item->number[PDU_NUMBER_LEN] = 0x00;
+  strncpy(item->text, message_str, SMS_BURST_TEXT_LEN);
+  item->text[SMS_BURST_TEXT_LEN] = 0x00;
+  burst_count++;
+
+  return (burst_count);
+}
+
+/**********************************************************
+Method sends all SMS from the burst queue
+In case there are more SMS in the queue the module is asked
+to keep the relay link to the SMSC open(AT+CMMS=1) so
+consecutive SMS don't pay the link setup again.
+The link is released(AT+CMMS=0) after the last SMS.
+
+Number of sent SMS and the time of the whole burst are
+placed to the burstSent and burstTime(msec.).
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+
+        OK ret val:
+        -----------
+        0.. number of sent SMS
+            (not sent SMS are removed from the queue too)
+
+
+an example of usage:
+        gsm.QueueSMS(phone_num, "OUT1 IS ON");
+        gsm.QueueSMS(phone_num, "OUT2 IS OFF");
+        gsm.FlushSMSBurst();
+        // gsm.burstSent SMS in gsm.burstTime msec.
+**********************************************************/
+char GSM::FlushSMSBurst(void)
+{
+  char ret_val = -1;
+  byte keep_link;
+  sms_out_t *item;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  ret_val = 0;
+  burstTime = millis();
+
+  keep_link = (burst_count > 1);
+  if (keep_link) {
+    // keep the link open - it is closed automatically by the module
+    // if there is no other SMS within the module timeout
+    SetCommLineStatus(CLS_ATCMD);
+    SendATCmdWaitResp("AT+CMMS=1", START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", 1);
+    SetCommLineStatus(CLS_FREE);
+  }
+
+  while (burst_count) {
+    item = &burst_queue[burst_head];
+    if (SendSMS(item->number, item->text) == 1) ret_val++;
+    burst_head = (burst_head + 1) % burst_queue_len;
+    burst_count--;
+  }
+
+  if (keep_link) {
+    SetCommLineStatus(CLS_ATCMD);
+    SendATCmdWaitResp("AT+CMMS=0", START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK", 1);
+    SetCommLineStatus(CLS_FREE);
+  }
+
+  burstTime = millis() - burstTime;
+  burstSent = ret_val;
+  return (ret_val);
+}
+
+/**********************************************************
+Method returns status SMSQ_... of the slot in the EEPROM queue
+**********************************************************/
+byte GSM::SMSQueueGetStatus(byte slot)
+{
+  switch (eeprom_read_byte((uint8_t *)(SMSQ_SLOT_ADDR(slot) + SMSQ_OFS_STATUS))) {
+    case SMSQ_EE_PENDING: return (SMSQ_PENDING);
+    case SMSQ_EE_SENT:    return (SMSQ_SENT);
+    case SMSQ_EE_FAILED:  return (SMSQ_FAILED);
+  }
+  return (SMSQ_UNKNOWN);
+}
+
+/**********************************************************
+Method restores the persistent SMS queue after reset
+Queue lives in the EEPROM area SMS_QUEUE_EEPROM_ADDR ..
+SMS_QUEUE_EEPROM_END, slots are used round-robin so the
+EEPROM wear is spread over the whole area.
+SMS which were pending before the reset are sent again
+by the PollSMSQueue().
+
+Method must be called once in the setup() before the queue
+is used.
+
+
+an example of usage:
+        GSM gsm;
+
+        gsm.InitSMSQueue();
+**********************************************************/
+void GSM::InitSMSQueue(void)
+{
+  byte slot;
+  byte found = 0;
+  uint16_t seq;
+  uint16_t max_seq = 0;
+
+  smsq_next_slot = 0;
+  smsq_next_seq = 1;
+  smsq_retry_wait = 0;
+
+  // the newest SMS has the highest seq. number
+  // (serial number arithmetic - seq. number can overflow)
+  for (slot = 0; slot < SMS_QUEUE_SLOTS; slot++) {
+    if (SMSQ_UNKNOWN == SMSQueueGetStatus(slot)) continue;
+    seq = eeprom_read_word((uint16_t *)(SMSQ_SLOT_ADDR(slot) + SMSQ_OFS_SEQ));
+    if (!found || (int16_t)(seq - max_seq) > 0) {
+      max_seq = seq;
+      smsq_next_slot = (slot + 1) % SMS_QUEUE_SLOTS;
+      found = 1;
+    }
+  }
+  if (found) {
+    smsq_next_seq = max_seq + 1;
+  }
+}
+
+/**********************************************************
+Method stores SMS to the persistent queue in the EEPROM
+SMS is sent later in the background by the PollSMSQueue()
+and it survives reset or power loss of the Arduino.
+
+The body of the slot is written first and the status byte
+as the last one, so the slot interrupted by a reset is not
+taken as the valid SMS.
+
+number_str:   pointer to the phone number string
+message_str:  pointer to the SMS text string
+              (longer text is cut to SMS_QUEUE_TEXT_LEN)
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - queue is full (the oldest slot is still pending)
+
+        OK ret val:
+        -----------
+        0..32767 - id of the queued SMS, see SMSQueueStatus()
+
+
+an example of usage:
+        GSM gsm;
+        int id;
+
+        id = gsm.QueueSMSEEPROM("00XXXYYYYYYYYY", "Power failure");
+        ...
+        gsm.PollSMSQueue(); // in the loop()
+**********************************************************/
+int GSM::QueueSMSEEPROM(char *number_str, char *message_str)
+{
+  int addr;
+  byte i;
+  byte len;
+
+  if (SMSQ_PENDING == SMSQueueGetStatus(smsq_next_slot)) return (-1);
+
+  addr = SMSQ_SLOT_ADDR(smsq_next_slot);
+  // invalidate slot first
+  EEPROMUpdate(addr + SMSQ_OFS_STATUS, 0xFF);
+
+  eeprom_write_word((uint16_t *)(addr + SMSQ_OFS_SEQ), smsq_next_seq);
+  EEPROMUpdate(addr + SMSQ_OFS_ATTEMPTS, 0);
+  for (i = 0; i < PDU_NUMBER_LEN && number_str[i] != 0x00; i++) {
+    EEPROMUpdate(addr + SMSQ_OFS_NUMBER + i, number_str[i]);
+  }
+  EEPROMUpdate(addr + SMSQ_OFS_NUMBER + i, 0x00);
+  for (len = 0; len < SMS_QUEUE_TEXT_LEN && message_str[len] != 0x00; len++) {
+    EEPROMUpdate(addr + SMSQ_OFS_TEXT + len, message_str[len]);
+  }
+  EEPROMUpdate(addr + SMSQ_OFS_LEN, len);
+
+  // now the slot is valid
+  EEPROMUpdate(addr + SMSQ_OFS_STATUS, SMSQ_EE_PENDING);
+
+  smsq_next_slot = (smsq_next_slot + 1) % SMS_QUEUE_SLOTS;
+  smsq_next_seq++;
+  return ((smsq_next_seq - 1) & 0x7FFF);
+}
+
+/**********************************************************
+Method returns status of the SMS in the persistent queue
+
+id: id returned by the QueueSMSEEPROM()
+
+return:
+        SMSQ_UNKNOWN - SMS was not found(it was overwritten by
+                       a newer SMS)
+        SMSQ_PENDING - SMS waits for sending
+        SMSQ_SENT    - SMS was sent
+        SMSQ_FAILED  - SMS was not sent within SMS_QUEUE_MAX_ATTEMPTS
+**********************************************************/
+byte GSM::SMSQueueStatus(int id)
+{
+  byte slot;
+  byte status;
+  uint16_t seq;
+
+  for (slot = 0; slot < SMS_QUEUE_SLOTS; slot++) {
+    status = SMSQueueGetStatus(slot);
+    if (SMSQ_UNKNOWN == status) continue;
+    seq = eeprom_read_word((uint16_t *)(SMSQ_SLOT_ADDR(slot) + SMSQ_OFS_SEQ));
+    if ((seq & 0x7FFF) == (uint16_t)id) return (status);
+  }
+  return (SMSQ_UNKNOWN);
+}
+
+/**********************************************************
+Method returns number of SMS waiting in the persistent queue
+**********************************************************/
+byte GSM::SMSQueuePending(void)
+{
+  byte slot;
+  byte pending = 0;
+
+  for (slot = 0; slot < SMS_QUEUE_SLOTS; slot++) {
+    if (SMSQ_PENDING == SMSQueueGetStatus(slot)) pending++;
+  }
+  return (pending);
+}
+
+/**********************************************************
+Method sends SMS stored in the EEPROM slot
+Number and text are streamed directly from the EEPROM
+so no RAM buffer is necessary.
+
+addr: EEPROM address of the slot
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - GSM module has answered "ERROR" string
+
+        OK ret val:
+        -----------
+        1 - SMS was sent
+**********************************************************/
+char GSM::SendSMSFromEEPROM(int addr)
+{
+  char ret_val = -1;
+  byte i;
+  byte ch;
+  byte len;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = -2; // still not send
+  SelectSMSMode(SMS_MODE_TEXT);
+
+  // send  AT+CMGS="number_str"
+  outSerial.print(F("AT+CMGS=\""));
+  for (i = 0; i < PDU_NUMBER_LEN; i++) {
+    ch = eeprom_read_byte((uint8_t *)(addr + SMSQ_OFS_NUMBER + i));
+    if (ch == 0x00) break;
+    outSerial.write(ch);
+  }
+  outSerial.print(F("\"\r"));
+
+  if (RX_FINISHED_STR_RECV == WaitPrompt(START_LONG_COMM_TMOUT)) {
+    len = eeprom_read_byte((uint8_t *)(addr + SMSQ_OFS_LEN));
+    if (len > SMS_QUEUE_TEXT_LEN) len = SMS_QUEUE_TEXT_LEN;
+    for (i = 0; i < len; i++) {
+      outSerial.write(eeprom_read_byte((uint8_t *)(addr + SMSQ_OFS_TEXT + i)));
+    }
+
+#ifdef DEBUG_SMS_ENABLED
+    // SMS will not be sent = we will not pay => good for debugging
+    outSerial.write(27);
+    switch (WaitResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK")) {
+#else
+    outSerial.write(26);
+    switch (WaitFinalResp(START_XXLONG_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "+CMGS")) {
+#endif
+      case RX_FINISHED_STR_RECV:
+        // SMS was send correctly
+        ret_val = 1;
+        break;
+      case RX_FINISHED_STR_NOT_RECV:
+        ret_val = -3;
+        break;
+      default:
+        break;
+    }
+  }
+
+  SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method sends the oldest pending SMS from the persistent queue
+Method is intended to be called periodically from the loop().
+Only one SMS is sent per call and nothing is done if:
+- the comm. line to the GSM module is not free
+- the GSM module is not registered in the network
+- the retry delay SMS_QUEUE_RETRY_TMOUT after the previous
+  unsuccessful attempt has not elapsed yet
+
+After SMS_QUEUE_MAX_ATTEMPTS unsuccessful attempts
+the SMS is marked as SMSQ_FAILED and the next one is sent.
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - nothing was sent(line busy, not registered, retry delay)
+        -2 - attempt was not successful, SMS is sent again later
+        -3 - SMS was marked as failed
+
+        OK ret val:
+        -----------
+        0 - no pending SMS in the queue
+        1 - SMS was sent
+
+
+an example of usage:
+        void loop()
+        {
+          gsm.PollSMSQueue();
+          ...
+        }
+**********************************************************/
+char GSM::PollSMSQueue(void)
+{
+  byte slot;
+  byte oldest = 0;
+  byte found = 0;
+  byte attempts;
+  uint16_t seq;
+  uint16_t min_seq = 0;
+  int addr;
+
+  if (CLS_FREE != GetCommLineStatus()) return (-1);
+  if (smsq_retry_wait) {
+    if ((unsigned long)(millis() - smsq_retry_time) < SMS_QUEUE_RETRY_TMOUT) return (-1);
+    smsq_retry_wait = 0;
+  }
+
+  // the oldest pending SMS has the lowest seq. number
+  for (slot = 0; slot < SMS_QUEUE_SLOTS; slot++) {
+    if (SMSQ_PENDING != SMSQueueGetStatus(slot)) continue;
+    seq = eeprom_read_word((uint16_t *)(SMSQ_SLOT_ADDR(slot) + SMSQ_OFS_SEQ));
+    if (!found || (int16_t)(seq - min_seq) < 0) {
+      min_seq = seq;
+      oldest = slot;
+      found = 1;
+    }
+  }
+  if (!found) return (0);
+
+  if (!IsRegistered()) return (-1);
+
+  addr = SMSQ_SLOT_ADDR(oldest);
+  if (SendSMSFromEEPROM(addr) == 1) {
+    EEPROMUpdate(addr + SMSQ_OFS_STATUS, SMSQ_EE_SENT);
+    return (1);
+  }
+
+  attempts = eeprom_read_byte((uint8_t *)(addr + SMSQ_OFS_ATTEMPTS)) + 1;
+  if (attempts >= SMS_QUEUE_MAX_ATTEMPTS) {
+    EEPROMUpdate(addr + SMSQ_OFS_STATUS, SMSQ_EE_FAILED);
+    return (-3);
+  }
+  EEPROMUpdate(addr + SMSQ_OFS_ATTEMPTS, attempts);
+  smsq_retry_wait = 1;
+  smsq_retry_time = millis();
+  return (-2);
+}
+
+/**********************************************************
+Method initializes delivery report tracking
+Table is allocated by the user, one item for every sent SMS
+which waits for the status report. Status reports are
+requested for all SMS sent in the text mode(AT+CSMP) and
+the module is configured to send them directly to the
+serial line as +CDS unsolicited messages(AT+CNMI).
+
+Method must be called after InitParam(PARAM_SET_1) because
+AT+CNMI setting is overwritten there.
+
+table:        pointer to the table
+num_of_slots: number of items in the table
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - GSM module has answered "ERROR" string
+
+        OK ret val:
+        -----------
+        0 - there is no table(NULL or 0 items), tracking is disabled
+        1 - status reports are enabled
+
+
+an example of usage:
+        GSM gsm;
+        dlr_slot_t dlr_table[8];
+
+        gsm.InitDeliveryReports(dlr_table, 8);
+**********************************************************/
+char GSM::InitDeliveryReports(dlr_slot_t *table, byte num_of_slots)
+{
+  char ret_val = -1;
+  byte i;
+
+  dlr_table = table;
+  dlr_slots = num_of_slots;
+  if (dlr_table == NULL || dlr_slots == 0) {
+    dlr_table = NULL;
+    dlr_slots = 0;
+    return (0);
+  }
+  for (i = 0; i < dlr_slots; i++) dlr_table[i].state = DLR_FREE;
+  dlrDelivered = 0;
+  dlrLatencySum = 0;
+  dlrLatencyMax = 0;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  // first octet 49 = SMS-SUBMIT, relative validity period, status report request
+  ret_val = SetStatusReport(1);
+  if (ret_val == AT_RESP_OK) {
+    // status reports are routed to the serial line: +CDS: ...
+    ret_val = SendCNMI();
+  }
+  SetCommLineStatus(CLS_FREE);
+  if (ret_val == AT_RESP_OK) ret_val = 1;
+  return (ret_val);
+}
+
+/**********************************************************
+Method finds item of the tracking table for the message
+reference (open addressing, linear probing)
+
+return: pointer to the item or NULL
+**********************************************************/
+dlr_slot_t *GSM::DLRFind(byte mr)
+{
+  byte i;
+  byte pos;
+
+  if (dlr_table == NULL) return (NULL);
+  pos = mr % dlr_slots;
+  for (i = 0; i < dlr_slots; i++) {
+    if (dlr_table[pos].state == DLR_FREE) break;
+    if (dlr_table[pos].mr == mr) return (&dlr_table[pos]);
+    pos = (pos + 1) % dlr_slots;
+  }
+  return (NULL);
+}
+
+/**********************************************************
+Method updates the tracked SMS by the received status report
+
+mr: message reference from the status report
+st: status from the status report
+
+return: 0 - SMS is not tracked or report is not final
+        1 - SMS state was changed to DLR_DELIVERED or DLR_FAILED
+**********************************************************/
+char GSM::DLRReport(byte mr, byte st)
+{
+  unsigned long latency;
+  dlr_slot_t *item;
+
+  item = DLRFind(mr);
+  // st 32..63 - SC still tries to deliver, wait for the next report
+  if (item == NULL || item->state != DLR_PENDING || (st >= 32 && st <= 63)) {
+    return (0);
+  }
+  latency = millis() - item->time;
+  item->time = latency;
+  if (st < 32) {
+    item->state = DLR_DELIVERED;
+    dlrDelivered++;
+    dlrLatencySum += latency;
+    if (latency > dlrLatencyMax) dlrLatencyMax = latency;
+  }
+  else item->state = DLR_FAILED;
+  return (1);
+}
+
+/**********************************************************
+Method starts tracking of the sent SMS
+SendSMSTracked() calls it automatically, it can be used
+also for the SMS sent by SendSMSPDU(sms, data, data_len, PDU_FLAG_SRR)
+with the sms->mr.
+
+Finished items(delivered, failed) and pending items older
+than DLR_TMOUT are reused. Because the message reference
+is only 8-bit, an older item with the same reference is
+replaced.
+
+mr: message reference of the sent SMS
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - table is full or not initialized
+
+        OK ret val:
+        -----------
+        1 - SMS is tracked
+**********************************************************/
+char GSM::TrackSMS(byte mr)
+{
+  byte i;
+  byte pos;
+  dlr_slot_t *item;
+
+  if (dlr_table == NULL) return (-1);
+
+  item = DLRFind(mr);
+  if (item == NULL) {
+    pos = mr % dlr_slots;
+    for (i = 0; i < dlr_slots; i++) {
+      if (dlr_table[pos].state != DLR_PENDING
+          || (unsigned long)(millis() - dlr_table[pos].time) >= DLR_TMOUT) {
+        item = &dlr_table[pos];
+        break;
+      }
+      pos = (pos + 1) % dlr_slots;
+    }
+  }
+  if (item == NULL) return (-1);
+
+  item->mr = mr;
+  item->state = DLR_PENDING;
+  item->time = millis();
+  return (1);
+}
+
+/**********************************************************
+Method sends SMS and starts tracking of its delivery
+
+number_str:   pointer to the phone number string
+message_str:  pointer to the SMS text string
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - GSM module has answered "ERROR" string
+
+        OK ret val:
+        -----------
+        0 - SMS was not sent
+        1 - SMS was sent, message reference is in the lastSMSRef
+            (it is tracked only if there is a place in the table)
+
+
+an example of usage:
+        GSM gsm;
+        byte mr;
+        unsigned long latency;
+
+        if (gsm.SendSMSTracked("00XXXYYYYYYYYY", "SMS text") == 1) {
+          mr = gsm.lastSMSRef;
+        }
+        ...
+        gsm.CheckDeliveryReports(); // in the loop()
+        if (gsm.DeliveryStatus(mr, &latency) == DLR_DELIVERED) ...
+**********************************************************/
+char GSM::SendSMSTracked(char *number_str, char *message_str)
+{
+  char ret_val;
+
+  ret_val = SendSMS(number_str, message_str);
+  if (ret_val == 1 && lastSMSRef >= 0) {
+    TrackSMS(lastSMSRef);
+  }
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads unsolicited messages already received from
+the GSM module and processes:
+- new SMS notifications +CMTI: <mem>,<index>
+  positions are stored for the NextNewSMS()
+- status reports in the text mode
+  +CDS: <fo>,<mr>,[<ra>],[<tora>],<scts>,<dt>,<st>
+  or in the PDU mode
+  +CDS: <length><CR><LF><pdu>
+  reports are matched with the tracking table, also reports
+  which came during other AT commands(see ScanCDS())
+
+Other unsolicited messages are discarded.
+
+new_sms:  pointer where number of new SMS notifications
+          is placed
+
+return: -1 - comm. line to the GSM module is not free
+        0.. number of matched status reports
+**********************************************************/
+char GSM::ReadURC(byte *new_sms)
+{
+  char ret_val = -1;
+  char *p_char;
+  byte position;
+  byte i;
+
+  *new_sms = 0;
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  ret_val = 0;
+
+  if (outSerial.available()) {
+    SetCommLineStatus(CLS_ATCMD);
+    // read all already received characters, don't flush them
+    // (status reports are collected by the IsRxFinished())
+    RxInit(START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, 0, 1);
+    while (RX_NOT_FINISHED == IsRxFinished());
+    SetCommLineStatus(CLS_FREE);
+
+    // new SMS notifications - the index is behind the comma
+    p_char = (char *)comm_buf;
+    while ((p_char = strstr(p_char, "+CMTI:")) != NULL) {
+      p_char += 6;
+      if (strchr(p_char, ',') == NULL) break;
+      position = atoi(strchr(p_char, ',') + 1);
+      if (position == 0) continue;
+      AddNewSMS(position);
+      (*new_sms)++;
+    }
+  }
+
+  // status reports - also those received together with
+  // the responses of other AT commands
+  for (i = 0; i < cds_count; i++) ret_val += DLRReport(cds_mr[i], cds_st[i]);
+  cds_count = 0;
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads status reports from the GSM module
+Status report in the text mode:
++CDS: <fo>,<mr>,[<ra>],[<tora>],<scts>,<dt>,<st>
+
+Method is intended to be called periodically from the loop(),
+the serial line is read only if there are some incoming
+characters. Reports which came during other AT commands are
+taken from their responses(max. CDS_PENDING_SLOTS reports
+between two calls). Reports are matched with the tracking table and
+delivery latency(time from sending to the report) is stored
+in the table and added to the dlrDelivered, dlrLatencySum
+and dlrLatencyMax statistics.
+
+Note: new SMS notifications received together with
+the reports are stored for the NextNewSMS(), other unsolicited
+messages are discarded.
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+
+        OK ret val:
+        -----------
+        0.. number of matched status reports
+
+
+an example of usage:
+        void loop()
+        {
+          gsm.CheckDeliveryReports();
+          // average latency: gsm.dlrLatencySum / gsm.dlrDelivered
+          ...
+        }
+**********************************************************/
+char GSM::CheckDeliveryReports(void)
+{
+  byte new_sms;
+
+  return (ReadURC(&new_sms));
+}
+
+/**********************************************************
+Method returns delivery status of the tracked SMS
+
+mr:       message reference of the SMS
+latency:  pointer where delivery latency(msec.) is placed
+          in case of DLR_DELIVERED/DLR_FAILED, can be NULL
+
+return:
+        DLR_FREE      - SMS is not tracked
+        DLR_PENDING   - status report was not received yet
+        DLR_DELIVERED - SMS was delivered
+        DLR_FAILED    - SMS could not be delivered
+**********************************************************/
+byte GSM::DeliveryStatus(byte mr, unsigned long *latency)
+{
+  dlr_slot_t *item;
+
+  item = DLRFind(mr);
+  if (item == NULL) return (DLR_FREE);
+  if (latency != NULL && item->state != DLR_PENDING) *latency = item->time;
+  return (item->state);
+}
+
+/**********************************************************
+Method sends AT+CNMI according to the enabled notifications
+- new SMS: +CMTI: "SM",<index>  (mt = 1)
+- status reports: +CDS: ...     (ds = 1)
+
+return: AT_RESP_... of the command
+**********************************************************/
+char GSM::SendCNMI(void)
+{
+  outSerial.print(F("AT+CNMI=2,"));
+  outSerial.print((int)sms_new_notify);
+  outSerial.print(F(",0,"));
+  outSerial.print((int)(dlr_table != NULL));
+  outSerial.print(F(",0\r"));
+  switch (WaitResp(START_SHORT_COMM_TMOUT, MAX_INTERCHAR_TMOUT, "OK")) {
+    case RX_TMOUT_ERR:
+      return (AT_RESP_ERR_NO_RESP);
+    case RX_FINISHED_STR_RECV:
+      return (AT_RESP_OK);
+  }
+  return (AT_RESP_ERR_DIF_RESP);
+}
+
+/**********************************************************
+Method enables new SMS notifications
+The GSM module sends +CMTI: "SM",<index> when a new SMS
+is stored so it is not necessary to poll the SIM card
+by the IsSMSPresent(). Notifications are read by the
+CheckNewSMS().
+
+Method must be called after InitParam(PARAM_SET_1) because
+AT+CNMI setting is overwritten there.
+
+Note: notification which comes during another AT command
+is lost together with the response, so it is recommended
+to call IsSMSPresent() rarely as well(e.g. once per minute).
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+        -2 - GSM module didn't answer in timeout
+        -3 - GSM module has answered "ERROR" string
+
+        OK ret val:
+        -----------
+        1 - notifications are enabled
+
+
+an example of usage:
+        gsm.InitParam(PARAM_SET_1);
+        gsm.InitNewSMSNotification();
+**********************************************************/
+char GSM::InitNewSMSNotification(void)
+{
+  char ret_val = -1;
+
+  sms_new_count = 0;
+  smsNewLost = 0;
+  sms_new_notify = 1;
+
+  if (CLS_FREE != GetCommLineStatus()) return (ret_val);
+  SetCommLineStatus(CLS_ATCMD);
+  ret_val = SendCNMI();
+  SetCommLineStatus(CLS_FREE);
+  if (ret_val == AT_RESP_OK) ret_val = 1;
+  return (ret_val);
+}
+
+/**********************************************************
+Method stores position of the notified SMS for NextNewSMS()
+- the same SMS is not stored twice
+The SMS occupies one more position of the storage for received
+SMS, so smsMemUsed[SMS_MEM_RECV] is updated too.
+**********************************************************/
+void GSM::AddNewSMS(byte position)
+{
+  byte i;
+
+  for (i = 0; i < sms_new_count; i++) {
+    if (sms_new_pos[i] == position) return;
+  }
+  if (smsMemUsed[SMS_MEM_RECV] < smsMemTotal[SMS_MEM_RECV]) smsMemUsed[SMS_MEM_RECV]++;
+  if (sms_new_count < SMS_NEW_SLOTS) sms_new_pos[sms_new_count++] = position;
+  else smsNewLost = 1;
+}
+
+/**********************************************************
+Method reads new SMS notifications from the GSM module
+Method is intended to be called from every pass of the loop(),
+the serial line is read only if there are some incoming
+characters so it doesn't block the loop.
+Status reports received together with the notifications
+are processed as by the CheckDeliveryReports().
+
+return:
+        ERROR ret. val:
+        ---------------
+        -1 - comm. line to the GSM module is not free
+
+        OK ret val:
+        -----------
+        0  - there is no new notification
+        1.. number of received notifications,
+            positions are returned by the NextNewSMS()
+**********************************************************/
+char GSM::CheckNewSMS(void)
+{
+  byte new_sms;
+
+  if (ReadURC(&new_sms) < 0) return (-1);
+  return (new_sms);
+}
+
+/**********************************************************
+Method returns position of the oldest notified SMS
+and removes it from the list of new SMS
+
+If smsNewLost is 1 some notifications did not fit
+to the list (SMS_NEW_SLOTS) - IsSMSPresent() should be
+used to find remaining SMS.
+
+return: 0  - there is no new SMS
+        1.. position of the SMS in the SIM card
+
+
+an example of usage:
+        void loop()
+        {
+          gsm.CheckNewSMS();
+          position = gsm.NextNewSMS();
+          if (position > 0) {
+            gsm.GetSMS(position, phone_num, sms_text, 100);
+            ...
+          }
+        }
+**********************************************************/
+byte GSM::NextNewSMS(void)
+{
+  byte position;
+
+  if (sms_new_count == 0) return (0);
+  position = sms_new_pos[0];
+  sms_new_count--;
+  memmove(sms_new_pos, sms_new_pos + 1, sms_new_count);
+  return (position);
+}
@@ -0,0 +1,211 @@
+/*
+	GSM_SMS.h - SMS library for the Advanced GPRS Shield - SiGAlabs
+	www.sigalabs.com
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __GSM_SMS
+#define __GSM_SMS
+
+#if defined(ARDUINO) && ARDUINO >= 100
+  #include "Arduino.h"
+  #else
+  #include "WProgram.h"
+#endif
+
+#include "GSM_PDU.h"
+
+
+#define SMS_LIB_VERSION 109 // library version X.YY (e.g. 1.00)
+/*
+    Version
+    --------------------------------------------------------------------------
+    100       Initial version
+              Concatenated SMS sending and reassembly of received parts
+    --------------------------------------------------------------------------
+    101       SendSMSBroadcast() added: SMS is stored once(AT+CMGW) and sent
+              to all recipients from the storage(AT+CMSS)
+    --------------------------------------------------------------------------
+    102       SMS burst: queued SMS are sent with AT+CMMS so the relay
+              link is kept open between consecutive SMS
+    --------------------------------------------------------------------------
+    103       Persistent outgoing SMS queue in the EEPROM, SMS are sent
+              in the background by PollSMSQueue()
+    --------------------------------------------------------------------------
+    104       Delivery report tracking - sent SMS are matched with the
+              incoming status reports(+CDS) by the message reference
+    --------------------------------------------------------------------------
+    105       New SMS notifications(+CMTI) - the SIM card doesn't have to be
+              polled, see CheckNewSMS() and NextNewSMS()
+    --------------------------------------------------------------------------
+    106       Status reports in the PDU mode(+CDS: <length>) are also matched
+              with the tracking table
+    --------------------------------------------------------------------------
+    107       Status reports which came together with the responses of other
+              AT commands are not lost, InitDeliveryReports() with 0 items
+              disables the tracking
+    --------------------------------------------------------------------------
+    108       InitConcatSMS() with 0 items disables the reassembly,
+              AddConcatPart() returns CONCAT_ERR_BUFFER for the 0 size buffer
+    --------------------------------------------------------------------------
+    109       SendSMSBroadcast() returns int, more than 127 recipients
+              are counted correctly
+    --------------------------------------------------------------------------
+*/
+
+// user data header information elements
+#define UDH_IEI_CONCAT_8BIT   0x00  // concatenated SMS, 8-bit reference
+#define UDH_IEI_CONCAT_16BIT  0x08  // concatenated SMS, 16-bit reference
+
+// max. user data of one part of the concatenated SMS
+// (160 septets/140 octets minus 6 octets of the UDH)
+#define CONCAT_PART_SEPTETS   153
+#define CONCAT_PART_OCTETS    134
+
+// max. number of parts of one reassembled SMS (max. 8)
+#ifndef CONCAT_MAX_PARTS
+	#define CONCAT_MAX_PARTS      3
+#endif // end of ifndef CONCAT_MAX_PARTS
+
+// max. length of one received part
+#ifndef CONCAT_PART_LEN
+	#define CONCAT_PART_LEN       CONCAT_PART_SEPTETS
+#endif // end of ifndef CONCAT_PART_LEN
+
+// incomplete SMS is discarded if no other part comes within this time
+#ifndef CONCAT_TMOUT
+	#define CONCAT_TMOUT          300000
+#endif // end of ifndef CONCAT_TMOUT
+
+// return values of the AddConcatPart() method
+enum concat_ret_val_enum
+{
+  CONCAT_ERR_BUFFER = -3,     // there is no output buffer(max_msg_len is 0)
+  CONCAT_ERR_NO_TABLE = -2,   // reassembly table was not initialized
+  CONCAT_ERR_PART = -1,       // part can not be stored(too many parts, too long)
+  CONCAT_PART_STORED = 0,     // part was stored, SMS is not complete yet
+  CONCAT_COMPLETE,            // SMS is complete and copied to the output buffer
+  CONCAT_SINGLE,              // not concatenated SMS, copied to the output buffer
+
+  CONCAT_LAST_ITEM
+};
+
+// one item of the reassembly table
+// table is allocated by the user sketch, see InitConcatSMS()
+typedef struct
+{
+  char number[PDU_NUMBER_LEN+1];  // sender
+  uint16_t ref;                   // reference number of the concatenated SMS
+  byte total;                     // total number of parts, 0 = item is free
+  byte received;                  // received parts - bit 0 = part #1
+  unsigned long last_time;        // time when the last part was received
+  byte part_len[CONCAT_MAX_PARTS];
+  byte part[CONCAT_MAX_PARTS][CONCAT_PART_LEN];
+} concat_slot_t;
+
+// max. length of the text of the SMS in the burst queue
+#ifndef SMS_BURST_TEXT_LEN
+	#define SMS_BURST_TEXT_LEN    160
+#endif // end of ifndef SMS_BURST_TEXT_LEN
+
+// one item of the outgoing burst queue
+// queue is allocated by the user sketch, see InitSMSBurst()
+typedef struct
+{
+  char number[PDU_NUMBER_LEN+1];
+  char text[SMS_BURST_TEXT_LEN+1];
+} sms_out_t;
+
+// persistent SMS queue in the EEPROM
+// first EEPROM address used by the queue
+#ifndef SMS_QUEUE_EEPROM_ADDR
+	#define SMS_QUEUE_EEPROM_ADDR 0
+#endif // end of ifndef SMS_QUEUE_EEPROM_ADDR
+
+// number of SMS which can be stored in the queue
+#ifndef SMS_QUEUE_SLOTS
+	#define SMS_QUEUE_SLOTS       6
+#endif // end of ifndef SMS_QUEUE_SLOTS
+
+// max. length of the text of the queued SMS
+#ifndef SMS_QUEUE_TEXT_LEN
+	#define SMS_QUEUE_TEXT_LEN    100
+#endif // end of ifndef SMS_QUEUE_TEXT_LEN
+
+// SMS is marked as failed after this number of unsuccessful attempts
+#ifndef SMS_QUEUE_MAX_ATTEMPTS
+	#define SMS_QUEUE_MAX_ATTEMPTS 5
+#endif // end of ifndef SMS_QUEUE_MAX_ATTEMPTS
+
+// delay before next attempt after the unsuccessful one (msec.)
+#ifndef SMS_QUEUE_RETRY_TMOUT
+	#define SMS_QUEUE_RETRY_TMOUT 30000
+#endif // end of ifndef SMS_QUEUE_RETRY_TMOUT
+
+// layout of one slot in the EEPROM:
+// <status><seq. number - 2 bytes><attempts><text length><number><text>
+#define SMSQ_OFS_STATUS       0
+#define SMSQ_OFS_SEQ          1
+#define SMSQ_OFS_ATTEMPTS     3
+#define SMSQ_OFS_LEN          4
+#define SMSQ_OFS_NUMBER       5
+#define SMSQ_OFS_TEXT         (SMSQ_OFS_NUMBER + PDU_NUMBER_LEN + 1)
+#define SMSQ_SLOT_SIZE        (SMSQ_OFS_TEXT + SMS_QUEUE_TEXT_LEN)
+// end of the EEPROM area used by the queue
+#define SMS_QUEUE_EEPROM_END  (SMS_QUEUE_EEPROM_ADDR + SMS_QUEUE_SLOTS * SMSQ_SLOT_SIZE)
+
+// status of the queued SMS
+enum sms_queue_status_enum
+{
+  SMSQ_UNKNOWN = 0,   // slot is free or SMS has been already overwritten
+  SMSQ_PENDING,       // SMS waits for sending
+  SMSQ_SENT,          // SMS was sent
+  SMSQ_FAILED,        // SMS was not sent within SMS_QUEUE_MAX_ATTEMPTS
+
+  SMSQ_LAST_ITEM
+};
+
+// delivery report is not expected any more after this time (msec.)
+// and the item of the tracking table can be reused
+#ifndef DLR_TMOUT
+	#define DLR_TMOUT             3600000
+#endif // end of ifndef DLR_TMOUT
+
+// state of the tracked SMS
+enum dlr_state_enum
+{
+  DLR_FREE = 0,       // item is free/SMS is not tracked
+  DLR_PENDING,        // SMS was sent, status report was not received yet
+  DLR_DELIVERED,      // SMS was delivered to the recipient
+  DLR_FAILED,         // SMS could not be delivered
+
+  DLR_LAST_ITEM
+};
+
+// one item of the delivery report tracking table
+// table is allocated by the user sketch, see InitDeliveryReports()
+typedef struct
+{
+  byte state;           // DLR_...
+  byte mr;              // message reference
+  unsigned long time;   // time of sending, delivery latency after the report
+} dlr_slot_t;
+
+// max. number of notified SMS which wait for the reading
+#ifndef SMS_NEW_SLOTS
+	#define SMS_NEW_SLOTS         4
+#endif // end of ifndef SMS_NEW_SLOTS
+
+
+#endif
@@ -0,0 +1,248 @@
+/*
+    ArduMon main loop benchmark with Advanced GPRS Shield - SiGAlabs (www.sigalabs.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+    Description
+    -----------------------------------
+    This sketch runs the same SMS service with two main loops
+    of the ArduMon project, each of them for BENCH_TIME:
+    first the old one(LED blinking by delay() and IsSMSPresent()
+    driven by the pass counter), then the new one(+CMTI
+    notifications and millis() timers).
+    Send some SMS to the shield in both phases - every SMS is
+    answered by "OK" and deleted. The time of the SMS arrival
+    is taken from the +CMTI notification in both loops, so
+    the SMS-in to SMS-out latency is comparable.
+    At the end the latency(avg/max) and the share of idle loop
+    time of both loops are sent as SMS to the number below.
+
+    Fill in your number below.
+    Have fun!!
+ */
+
+#include "GSM.h"
+
+#define SMS_MAX_LEN  100
+#define BENCH_TIME   600000   // time of one phase (msec.)
+
+// timing of the new loop (msec.)
+#define REG_PERIOD   10000
+#define POLL_PERIOD  60000
+#define LED_PERIOD   3000
+#define LED_ON_TIME  200
+
+// definition of instance of GSM class
+GSM gsm;
+
+char number[] = "1234567890";
+char report[160];
+char phone_num[20];
+char sms_text[SMS_MAX_LEN];
+int ledPin = 13;
+
+// results of one phase
+typedef struct {
+  unsigned long latency_sum;  // SMS-in to SMS-out latency (msec.)
+  unsigned long latency_max;
+  unsigned int replies;
+  unsigned long idle_msec;    // time when the loop had nothing to do
+  unsigned long idle_usec;
+} bench_t;
+
+bench_t bench_old;
+bench_t bench_new;
+bench_t *bench;
+
+unsigned long sms_in_time;
+unsigned long phase_start;
+
+// variables used for timing of the old loop
+unsigned long previous_timer;
+byte timer100msec;
+
+// variables used for timing of the new loop
+unsigned long reg_timer;
+unsigned long poll_timer;
+unsigned long led_timer;
+
+void AddIdle(unsigned long pass_start)
+{
+  bench->idle_usec += micros() - pass_start;
+  if (bench->idle_usec >= 1000) {
+    bench->idle_msec += bench->idle_usec / 1000;
+    bench->idle_usec %= 1000;
+  }
+}
+
+// -----------------------------------------
+// the same service for both loops
+// -----------------------------------------
+void ProcessSMS(byte position)
+{
+  unsigned long latency;
+
+  gsm.GetSMS(position, phone_num, sms_text, SMS_MAX_LEN);
+  gsm.SendSMS(phone_num, "OK");
+
+  latency = millis() - sms_in_time;
+  bench->latency_sum += latency;
+  if (latency > bench->latency_max) bench->latency_max = latency;
+  bench->replies++;
+
+  while (gsm.DeleteSMS(position) != 1) {
+     delay(500);
+  }
+}
+
+// -----------------------------------------
+// old loop - one pass, kept as it was in the ardumon.pde
+// (the 100 msec. block is empty so the counter is incremented
+// in every pass)
+// the notification only marks the arrival time, positions
+// are not used, SMS is found by IsSMSPresent() as before
+// -----------------------------------------
+void OldLoop(void)
+{
+  unsigned long pass_start = micros();
+  byte busy = 0;
+  char position;
+
+  if (gsm.CheckNewSMS() > 0) {
+    sms_in_time = millis();
+    while (gsm.NextNewSMS() > 0);
+  }
+
+  if ((unsigned long)(millis() - previous_timer) >= 100) {
+    previous_timer = millis();
+  }
+
+  if ((timer100msec + 4) % 30 == 0) {
+    if (gsm.IsRegistered()) {
+      digitalWrite(ledPin, HIGH);
+      delay(200);
+      digitalWrite(ledPin, LOW);
+      delay(200);
+
+      position = gsm.IsSMSPresent(SMS_ALL);
+      if (position > 0) ProcessSMS(position);
+      busy = 1;
+    }
+  }
+  timer100msec = (timer100msec + 1) % 100;
+
+  if (!busy) AddIdle(pass_start);
+}
+
+// -----------------------------------------
+// new loop - one pass(as in the ardumon.pde)
+// -----------------------------------------
+void NewLoop(void)
+{
+  unsigned long pass_start = micros();
+  byte busy = 0;
+  char position;
+
+  if ((unsigned long)(millis() - reg_timer) >= REG_PERIOD) {
+    reg_timer = millis();
+    gsm.CheckRegistration();
+    busy = 1;
+  }
+
+  if (gsm.IsRegistered()) {
+    if (gsm.CheckNewSMS() > 0) {
+      sms_in_time = millis();
+      busy = 1;
+    }
+    position = gsm.NextNewSMS();
+    if (position > 0) {
+      ProcessSMS(position);
+      busy = 1;
+    }
+
+    if ((unsigned long)(millis() - poll_timer) >= POLL_PERIOD || gsm.smsNewLost) {
+      poll_timer = millis();
+      gsm.smsNewLost = 0;
+      position = gsm.IsSMSPresent(SMS_ALL);
+      if (position > 0) {
+        sms_in_time = millis();
+        ProcessSMS(position);
+      }
+      busy = 1;
+    }
+  }
+
+  if ((unsigned long)(millis() - led_timer) >= LED_PERIOD) {
+    led_timer = millis();
+    digitalWrite(ledPin, HIGH);
+  }
+  else if ((unsigned long)(millis() - led_timer) >= LED_ON_TIME) {
+    digitalWrite(ledPin, LOW);
+  }
+
+  if (!busy) AddIdle(pass_start);
+}
+
+
+void setup()
+{
+  pinMode(ledPin, OUTPUT);
+
+  // initialization of serial line
+  gsm.InitSerLine(9600);
+  // turn on GSM module
+  gsm.TurnOn();
+
+  // wait until a GSM module is registered in the GSM network
+  while (!gsm.IsRegistered()) {
+    gsm.CheckRegistration();
+    delay(1000);
+  }
+  // arrival time is taken from +CMTI in both loops
+  while (gsm.InitNewSMSNotification() != 1) delay(1000);
+
+  // old loop
+  bench = &bench_old;
+  timer100msec = 0;
+  previous_timer = millis();
+  phase_start = millis();
+  while ((unsigned long)(millis() - phase_start) < BENCH_TIME) OldLoop();
+
+  // new loop
+  bench = &bench_new;
+  reg_timer = millis();
+  poll_timer = millis();
+  led_timer = millis();
+  phase_start = millis();
+  while ((unsigned long)(millis() - phase_start) < BENCH_TIME) NewLoop();
+
+  // latency avg/max in msec. and idle time in % for both loops
+  sprintf(report, "old: %lu/%lu ms %u%% idle, new: %lu/%lu ms %u%% idle (%u/%u SMS)",
+          bench_old.replies ? bench_old.latency_sum / bench_old.replies : 0UL,
+          bench_old.latency_max,
+          (unsigned int)(bench_old.idle_msec / (BENCH_TIME / 100)),
+          bench_new.replies ? bench_new.latency_sum / bench_new.replies : 0UL,
+          bench_new.latency_max,
+          (unsigned int)(bench_new.idle_msec / (BENCH_TIME / 100)),
+          bench_old.replies, bench_new.replies);
+  gsm.SendSMS(number, report);
+}
+
+
+void loop()
+{
+
+}
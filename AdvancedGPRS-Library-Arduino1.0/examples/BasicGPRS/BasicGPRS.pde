@@ -27,6 +27,15 @@ uint16_t num_of_rx_bytes;
 byte* ptr_to_data;
 byte buffer[400];
 
+// GET request is sent in segments - constant parts stay in the flash
+// and no buffer for the whole request is necessary
+const char http_get[] PROGMEM = "GET / HTTP/1.1\r\nHost: ";
+const char http_end[] PROGMEM = "\r\n\r\n";
+char host[] = "www.google.com";
+gprs_seg_t request[] = {{http_get, 0, GPRS_SEG_PGM},
+                        {host, 0, GPRS_SEG_RAM},
+                        {http_end, 0, GPRS_SEG_PGM}};
+
 
 void setup()
 {
@@ -61,14 +70,16 @@ void loop()
   // to demonstrate a possibility to use AT command interface(call, SMS etc.) and GPRS connection "together"
   // -------------------------------------------------------------------------------------------------------
   for (byte i = 0; i < 3; i++) {
-    // open the TCP socket
-    ret_val = gsm.OpenSocket(TCP_SOCKET, 80, "www.google.com");
-    if (ret_val == 1) {
-      // socket was successfully opened
+    // the TCP socket is opened only for the first request
+    // other requests reuse the same connection - it is opened again
+    // only if it was closed by the server(NO CARRIER, AT+CIPSTATUS)
+    ret_val = gsm.KeepSocket(TCP_SOCKET, 80, host);
+    if (ret_val > 0) {
+      // socket is opened
       // so we can exchange data
       // here we are trying GET request
       // GET request must be finished by sequence <CR><LF><CR><LF> == \r\n\r\n
-      gsm.SendData("GET / HTTP/1.1\r\nHost: www.google.com\r\n\r\n");
+      gsm.SendData(request, 3);
       
       // and wait for first incomming data max. 20sec.
       // receiving will be finished either buffer is full 
@@ -92,8 +103,9 @@ void loop()
       } while (num_of_rx_bytes == COMM_BUF_LEN);
       
 
-      // now close the socket
-      gsm.CloseSocket();
+      // now leave the data mode - the socket stays opened
+      // and it is reused by the next KeepSocket()
+      gsm.LeaveDataMode();
 
       // and now we can try standard AT command - e.g. try to check registration
       // or we can check new SMS etc.
@@ -106,7 +118,8 @@ void loop()
 
     }
   }
-  // When finished deactivate GPRS context
+  // When finished close the socket and deactivate GPRS context
+  gsm.CloseSocket();
   gsm.DisableGPRS();
 
 
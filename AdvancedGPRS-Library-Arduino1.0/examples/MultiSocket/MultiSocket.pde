@@ -0,0 +1,109 @@
+/*
+    This sketch demostrates how to use several GPRS connections
+    at the same time (AT+CIPMUX=1)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+    Description
+    -----------------------------------
+    Three connections are opened together:
+    - telemetry: analog value is uploaded every 10 sec.
+    - command channel: received lines are echoed back
+    - time sync: UDP request every minute
+    Serial line stays free between AT commands so SMS etc.
+    can be used at the same time.
+
+    Fill in your servers below.
+    Have fun!!
+ */
+
+#include "GSM.h"
+
+// definition of instance of GSM class
+GSM gsm;
+
+gprs_socket_t sockets[3];
+char telemetry;
+char command;
+char time_sync;
+
+char record[40];
+byte rx_data[SOCK_RX_BUF_LEN];
+uint16_t len;
+unsigned long telemetry_timer;
+unsigned long time_sync_timer;
+
+
+void setup()
+{
+  // initialization of serial line
+  gsm.InitSerLine(9600);
+  // turn on GSM module
+  gsm.TurnOn();
+
+  // wait until a GSM module is registered in the GSM network
+  while (!gsm.IsRegistered()) {
+    gsm.CheckRegistration();
+    delay(1000);
+  }
+
+  // several connections, every one with its own receive buffer
+  gsm.InitSockets(sockets, 3);
+  gsm.InitGPRS("internet", "", "", GPRS_MODE_MULTI);
+  gsm.EnableGPRS(CLOSE_AND_REOPEN);
+
+  telemetry = gsm.SocketOpen(TCP_SOCKET, 8000, "telemetry.example.com");
+  command = gsm.SocketOpen(TCP_SOCKET, 8001, "command.example.com");
+  time_sync = gsm.SocketOpen(UDP_SOCKET, 37, "time.example.com");
+
+  telemetry_timer = millis();
+  time_sync_timer = millis();
+}
+
+
+void loop()
+{
+  // incoming data of all sockets are placed to their buffers
+  gsm.PollSockets();
+
+  // command channel - echo
+  if (command >= 0 && gsm.SocketAvailable(command)) {
+    len = gsm.SocketRead(command, rx_data, sizeof(rx_data));
+    gsm.SocketSend(command, rx_data, len);
+  }
+
+  // telemetry record every 10 sec.
+  if (telemetry >= 0 && (unsigned long)(millis() - telemetry_timer) >= 10000) {
+    telemetry_timer = millis();
+    sprintf(record, "A0=%i\r\n", analogRead(0));
+    gsm.SocketSend(telemetry, (byte *)record, strlen(record));
+  }
+
+  // time sync request every minute, answer is 4 bytes
+  if (time_sync >= 0 && (unsigned long)(millis() - time_sync_timer) >= 60000) {
+    time_sync_timer = millis();
+    gsm.SocketSend(time_sync, (byte *)"\n", 1);
+  }
+  if (time_sync >= 0 && gsm.SocketAvailable(time_sync) >= 4) {
+    gsm.SocketRead(time_sync, rx_data, 4);
+  }
+
+  // connection closed by the server - open it again
+  if (command >= 0 && gsm.SocketState(command) == SOCK_CLOSED) {
+    gsm.SocketClose(command);
+    command = gsm.SocketOpen(TCP_SOCKET, 8001, "command.example.com");
+  }
+}
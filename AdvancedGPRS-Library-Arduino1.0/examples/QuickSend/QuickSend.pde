@@ -0,0 +1,116 @@
+/*
+    Quick send with Advanced GPRS Shield - SiGAlabs (www.sigalabs.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+    Description
+    -----------------------------------
+    This sketch sends the same amount of data to the TCP server
+    twice: first in the normal mode where every AT+CIPSEND waits
+    for SEND OK(stop-and-wait), then in the quick send mode where
+    the next block is sent as soon as the module accepts the
+    previous one. In the quick send mode time is measured until
+    all data are acknowledged by the server(SocketAck()).
+    The throughput of both modes (bytes per second) is sent
+    as SMS to the number below.
+
+    Fill in your APN, server and number below.
+    Have fun!!
+ */
+
+#include "GSM.h"
+
+#define NUM_OF_BLOCKS   40
+#define BLOCK_LEN       256
+
+// definition of instance of GSM class
+GSM gsm;
+gprs_socket_t sockets[1];
+
+char number[] = "1234567890";
+char server[] = "upload.example.com";
+char report[80];
+byte block[BLOCK_LEN];
+
+
+// sends all blocks and returns the throughput in bytes per sec.
+unsigned int SendBlocks(void)
+{
+  unsigned long start;
+  unsigned long sent = 0;
+  char uplink;
+  byte i;
+
+  uplink = gsm.SocketOpen(TCP_SOCKET, 5000, server);
+  if (uplink < 0) return (0);
+
+  start = millis();
+  for (i = 0; i < NUM_OF_BLOCKS; i++) {
+    if (gsm.SocketSend(uplink, block, BLOCK_LEN) != BLOCK_LEN) break;
+    sent += BLOCK_LEN;
+  }
+  // all data must be received by the server
+  while (gsm.SocketAck(uplink) > 0 && millis() - start < 120000) {
+    gsm.PollSockets();
+  }
+  start = millis() - start;
+
+  gsm.SocketClose(uplink);
+  return (sent * 1000 / (start + 1));
+}
+
+
+void setup()
+{
+  unsigned int normal;
+  unsigned int quick;
+
+  memset(block, 'x', BLOCK_LEN);
+
+  // initialization of serial line
+  gsm.InitSerLine(115200);
+  // turn on GSM module
+  gsm.TurnOn();
+
+  // wait until a GSM module is registered in the GSM network
+  while (!gsm.IsRegistered()) {
+    gsm.CheckRegistration();
+    delay(1000);
+  }
+
+  gsm.InitSockets(sockets, 1);
+  gsm.InitGPRS("internet", "", "", GPRS_MODE_MULTI);
+  gsm.EnableGPRS(CLOSE_AND_REOPEN);
+
+  // stop-and-wait: SEND OK after every block
+  gsm.SetQuickSend(0);
+  normal = SendBlocks();
+
+  // pipelined blocks limited by the free space of the module
+  gsm.SetQuickSend(1);
+  quick = SendBlocks();
+
+  gsm.DisableGPRS();
+
+  sprintf(report, "Uplink B/s - stop-and-wait: %u, quick send: %u", normal, quick);
+  gsm.SendSMS(number, report);
+}
+
+
+void loop()
+{
+
+}
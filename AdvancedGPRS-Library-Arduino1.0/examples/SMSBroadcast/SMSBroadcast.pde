@@ -0,0 +1,85 @@
+/*
+    SMS broadcast with Advanced GPRS Shield - SiGAlabs (www.sigalabs.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+    Description
+    -----------------------------------
+    This sketch sends the same alert to several numbers twice:
+    first with the SendSMS() loop, then with SendSMSBroadcast()
+    which stores the text only once in the module.
+    Both times are measured and the result (messages per minute)
+    is sent as SMS to the first number.
+
+    Fill in your numbers below.
+    Have fun!!
+ */
+
+#include "GSM.h"
+
+#define NUM_OF_NUMBERS 3
+
+// definition of instance of GSM class
+GSM gsm;
+
+char *numbers[NUM_OF_NUMBERS] = {"1234567890", "1234567891", "1234567892"};
+char alert[] = "ALARM: input 1 is active!";
+char report[80];
+
+
+void setup()
+{
+  byte i;
+  byte sent_loop = 0;
+  int sent_broadcast;
+  unsigned long time_loop;
+  unsigned long time_broadcast;
+
+  // initialization of serial line
+  gsm.InitSerLine(9600);
+  // turn on GSM module
+  gsm.TurnOn();
+
+  // wait until a GSM module is registered in the GSM network
+  while (!gsm.IsRegistered()) {
+    gsm.CheckRegistration();
+    delay(1000);
+  }
+
+  // one SendSMS() per recipient
+  time_loop = millis();
+  for (i = 0; i < NUM_OF_NUMBERS; i++) {
+    if (gsm.SendSMS(numbers[i], alert) == 1) sent_loop++;
+  }
+  time_loop = millis() - time_loop;
+
+  // text is stored once and sent from the storage
+  time_broadcast = millis();
+  sent_broadcast = gsm.SendSMSBroadcast(numbers, NUM_OF_NUMBERS, alert);
+  time_broadcast = millis() - time_broadcast;
+
+  // messages per minute for both methods
+  sprintf(report, "SendSMS: %u msg/min, Broadcast: %u msg/min",
+          (unsigned int)(sent_loop * 60000UL / (time_loop + 1)),
+          (unsigned int)((sent_broadcast > 0 ? sent_broadcast : 0) * 60000UL / (time_broadcast + 1)));
+  gsm.SendSMS(numbers[0], report);
+}
+
+
+void loop()
+{
+
+}
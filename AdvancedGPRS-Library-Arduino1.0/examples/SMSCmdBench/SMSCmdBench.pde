@@ -0,0 +1,172 @@
+/*
+    SMS command parsing benchmark with Advanced GPRS Shield - SiGAlabs (www.sigalabs.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+    Description
+    -----------------------------------
+    This sketch parses the same set of SMS commands many times:
+    first in the old way(strtok_r copy of the text for every token
+    and strstr() chain), then with ParseCmd() and DispatchCmd().
+    Both times are measured and the result (usec. per message)
+    is sent as SMS to the number below.
+    GSM module is used only for sending of the result.
+
+    Fill in your number below.
+    Have fun!!
+ */
+
+#include "GSM.h"
+
+#define SMS_MAX_LEN     100
+#define NUM_OF_RUNS     200
+#define NUM_OF_MESSAGES 5
+
+// definition of instance of GSM class
+GSM gsm;
+
+char number[] = "1234567890";
+char report[80];
+char sms_text[SMS_MAX_LEN];
+cmd_span_t tokens[CMD_MAX_TOKENS];
+
+// test messages - the last command is in the table at the end
+// so the old if-chain must check all commands
+const char messages[NUM_OF_MESSAGES][30] PROGMEM = {
+  "ADMIN ANALOG",
+  "ADMIN INPUTS",
+  "ADMIN OUT1 ON",
+  "ADMIN OUT2 OFF",
+  "ADMIN OUTPUTS"
+};
+
+// every handler only counts calls, nothing is sent
+volatile unsigned int calls;
+
+char CmdCount(byte argc, cmd_arg_t *argv)
+{
+  calls++;
+  return (0);
+}
+
+const cmd_entry_t commands[] PROGMEM = {
+  {"ANALOG",  "",  0, CmdCount},
+  {"INPUTS",  "",  0, CmdCount},
+  {"OUT1",    "b", 1, CmdCount},
+  {"OUT2",    "b", 1, CmdCount},
+  {"OUTPUTS", "",  0, CmdCount}
+};
+#define NUM_OF_COMMANDS (sizeof(commands) / sizeof(cmd_entry_t))
+
+// the old way - copy of the text and strtok_r() for every token
+char* subStr (char* str, char *delim, int index) {
+   char *act, *sub, *ptr;
+   static char copy[SMS_MAX_LEN];
+   int i;
+
+   strcpy(copy, str);
+
+   for (i = 1, act = copy; i <= index; i++, act = NULL) {
+	sub = strtok_r(act, delim, &ptr);
+	if (sub == NULL) break;
+   }
+   return sub;
+}
+
+void OldParse(char *text)
+{
+  if (strstr(subStr(text, " ", 1), "ADMIN") == NULL) return;
+
+  if (strstr(subStr(text, " ", 2), "ANALOG") != NULL) calls++;
+  else if (strstr(subStr(text, " ", 2), "INPUTS") != NULL) calls++;
+  else if (strstr(subStr(text, " ", 2), "OUTPUTS") != NULL) calls++;
+  else if (strstr(subStr(text, " ", 2), "OUT1") != NULL) {
+    if (strstr(subStr(text, " ", 3), "ON") != NULL) calls++;
+    else if (strstr(subStr(text, " ", 3), "OFF") != NULL) calls++;
+  }
+  else if (strstr(subStr(text, " ", 2), "OUT2") != NULL) {
+    if (strstr(subStr(text, " ", 3), "ON") != NULL) calls++;
+    else if (strstr(subStr(text, " ", 3), "OFF") != NULL) calls++;
+  }
+}
+
+void NewParse(char *text)
+{
+  byte num_of_tokens;
+
+  num_of_tokens = gsm.ParseCmd(text, tokens, CMD_MAX_TOKENS);
+  if (num_of_tokens > 1 && gsm.CmdTokenIs(&tokens[0], "ADMIN")) {
+    gsm.DispatchCmd(commands, NUM_OF_COMMANDS, &tokens[1], num_of_tokens - 1);
+  }
+}
+
+
+void setup()
+{
+  int i;
+  byte j;
+  unsigned long time_old;
+  unsigned long time_new;
+  unsigned int calls_old;
+
+  // initialization of serial line
+  gsm.InitSerLine(9600);
+  // turn on GSM module
+  gsm.TurnOn();
+
+  // wait until a GSM module is registered in the GSM network
+  while (!gsm.IsRegistered()) {
+    gsm.CheckRegistration();
+    delay(1000);
+  }
+
+  // old way
+  calls = 0;
+  time_old = micros();
+  for (i = 0; i < NUM_OF_RUNS; i++) {
+    for (j = 0; j < NUM_OF_MESSAGES; j++) {
+      strcpy_P(sms_text, messages[j]);
+      OldParse(sms_text);
+    }
+  }
+  time_old = micros() - time_old;
+  calls_old = calls;
+
+  // tokens + command table
+  calls = 0;
+  time_new = micros();
+  for (i = 0; i < NUM_OF_RUNS; i++) {
+    for (j = 0; j < NUM_OF_MESSAGES; j++) {
+      strcpy_P(sms_text, messages[j]);
+      NewParse(sms_text);
+    }
+  }
+  time_new = micros() - time_new;
+
+  // usec. per message for both ways, number of recognized commands
+  // must be the same
+  sprintf(report, "strtok: %lu us/msg, table: %lu us/msg (%u/%u cmds)",
+          time_old / (NUM_OF_RUNS * NUM_OF_MESSAGES),
+          time_new / (NUM_OF_RUNS * NUM_OF_MESSAGES),
+          calls_old, calls);
+  gsm.SendSMS(number, report);
+}
+
+
+void loop()
+{
+
+}
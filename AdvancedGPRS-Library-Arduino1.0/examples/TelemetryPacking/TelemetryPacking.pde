@@ -0,0 +1,105 @@
+/*
+    Telemetry packing with Advanced GPRS Shield - SiGAlabs (www.sigalabs.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+    Description
+    -----------------------------------
+    This sketch sends the same telemetry records to the TCP server
+    twice in the transparent mode: first every record is passed
+    to the module at once, then records are collected in the send
+    buffer(InitSendBuffer()) and sent together.
+    Every block passed to the module is sent as one TCP segment
+    with 40 bytes of the IP and TCP headers, so the bytes on air
+    per record are estimated from the number of blocks(gprsTxFlushes).
+    The result is sent as SMS to the number below.
+
+    Fill in your APN, server and number below.
+    Have fun!!
+ */
+
+#include "GSM.h"
+
+#define NUM_OF_RECORDS  60
+#define RECORD_PERIOD   500     // msec. between records
+#define TCP_IP_HEADERS  40      // IPv4 + TCP header of one segment
+
+// definition of instance of GSM class
+GSM gsm;
+
+char number[] = "1234567890";
+char server[] = "telemetry.example.com";
+char report[80];
+char record[32];
+byte tx_buffer[240];
+
+
+// sends all records and returns the bytes on air per record
+unsigned int SendRecords(void)
+{
+  unsigned long payload = 0;
+  byte i;
+
+  gsm.gprsTxFlushes = 0;
+  if (gsm.OpenSocket(TCP_SOCKET, 8080, server) != 1) return (0);
+  for (i = 0; i < NUM_OF_RECORDS; i++) {
+    sprintf(record, "%u;%u;%u\r\n", i, analogRead(0), analogRead(1));
+    payload += gsm.BufferData(record);
+    delay(RECORD_PERIOD);
+  }
+  gsm.CloseSocket();
+  return ((payload + gsm.gprsTxFlushes * (unsigned long)TCP_IP_HEADERS) / NUM_OF_RECORDS);
+}
+
+
+void setup()
+{
+  unsigned int direct;
+  unsigned int buffered;
+
+  // initialization of serial line
+  gsm.InitSerLine(115200);
+  // turn on GSM module
+  gsm.TurnOn();
+
+  // wait until a GSM module is registered in the GSM network
+  while (!gsm.IsRegistered()) {
+    gsm.CheckRegistration();
+    delay(1000);
+  }
+
+  gsm.InitGPRS("internet", "", "");
+  gsm.EnableGPRS(CLOSE_AND_REOPEN);
+
+  // every record is passed to the module at once
+  gsm.InitSendBuffer(NULL, 0, 0);
+  direct = SendRecords();
+
+  // records are sent when the buffer is full or after 10 sec.
+  gsm.InitSendBuffer(tx_buffer, sizeof(tx_buffer), 10000);
+  buffered = SendRecords();
+
+  gsm.DisableGPRS();
+
+  sprintf(report, "Bytes on air per record - direct: %u, buffered: %u", direct, buffered);
+  gsm.SendSMS(number, report);
+}
+
+
+void loop()
+{
+
+}
@@ -43,17 +43,94 @@
 // definition of instance of GSM class
 GSM gsm;
 
+// timing of the main loop (msec.)
+#define REG_PERIOD   10000    // registration check
+#define POLL_PERIOD  60000    // SIM card check if a notification was lost
+#define LED_PERIOD   3000     // LED blinking
+#define LED_ON_TIME  200
+
 // variables used for timing
-unsigned long	previous_timer;
-byte timer100msec;
+unsigned long reg_timer;
+unsigned long poll_timer;
+unsigned long led_timer;
+byte notify_enabled;
+
+// statistics - reported by the STATS command
+unsigned long sms_in_time;    // time when the last SMS came
+unsigned long latency_sum;    // SMS-in to SMS-out latency (msec.)
+unsigned long latency_max;
+unsigned int replies;
+unsigned long idle_msec;      // time when the loop had nothing to do
+unsigned long idle_usec;
+unsigned long stats_start;
 
 char string[120];
-char position;          
+char reply[300];         // one reply for all commands of the SMS
 char phone_num[20];      // array for the phone number string
 char sms_text[SMS_MAX_LEN]; // array for the SMS text
+cmd_span_t tokens[CMD_MAX_TOKENS]; // tokens of the SMS text
+byte num_of_tokens;
  
 int ledPin = 13;  
 
+// -----------------------------------------
+// command handlers - results are collected to one reply
+// which is sent to the sender of the SMS
+// -----------------------------------------
+char CmdAnalog(byte argc, cmd_arg_t *argv)
+{
+  sprintf(string, "A0:%i A1:%i A2:%i A3:%i A4:%i A5:%i",analogRead(0),analogRead(1),analogRead(2),analogRead(3),analogRead(4),analogRead(5));
+  return (gsm.CmdReply(string));
+}
+
+char CmdInputs(byte argc, cmd_arg_t *argv)
+{
+  sprintf(string, "IN1:%i IN2:%i IN3:%i IN4:%i", digitalRead(IN1),digitalRead(IN2),digitalRead(IN3),digitalRead(IN4));
+  return (gsm.CmdReply(string));
+}
+
+char CmdOutputs(byte argc, cmd_arg_t *argv)
+{
+  sprintf(string, "OUT1:%i OUT2:%i", digitalRead(OUT1),digitalRead(OUT2));
+  return (gsm.CmdReply(string));
+}
+
+char SetOutput(byte pin, byte num, byte on)
+{
+  digitalWrite(pin, on ? HIGH : LOW);
+  sprintf(string, "OUT%i IS %s", num, on ? "ON" : "OFF");
+  return (gsm.CmdReply(string));
+}
+
+char CmdStats(byte argc, cmd_arg_t *argv)
+{
+  sprintf(string, "LAT avg:%lu max:%lu ms IDLE:%u%%",
+          replies ? latency_sum / replies : 0UL, latency_max,
+          (unsigned int)(idle_msec / ((millis() - stats_start) / 100 + 1)));
+  return (gsm.CmdReply(string));
+}
+
+char CmdOut1(byte argc, cmd_arg_t *argv)
+{
+  return (SetOutput(OUT1, 1, argv[0].val));
+}
+
+char CmdOut2(byte argc, cmd_arg_t *argv)
+{
+  return (SetOutput(OUT2, 2, argv[0].val));
+}
+
+// command table - must be sorted by the command name
+const cmd_entry_t commands[] PROGMEM = {
+  {"ANALOG",  "",  0, CmdAnalog},
+  {"INPUTS",  "",  0, CmdInputs},
+  {"OUT1",    "b", 1, CmdOut1},
+  {"OUT2",    "b", 1, CmdOut2},
+  {"OUTPUTS", "",  0, CmdOutputs},
+  {"STATS",   "",  0, CmdStats}
+};
+#define NUM_OF_COMMANDS (sizeof(commands) / sizeof(cmd_entry_t))
+
 void setup()
 {
   pinMode(ledPin, OUTPUT);      // sets the digital pin as output
@@ -76,139 +153,128 @@ void setup()
   gsm.InitSerLine(9600);		
   // turn on GSM module
   gsm.TurnOn();
+  // results of the commands are collected here
+  gsm.InitCmdReply(reply, sizeof(reply));
   
-  // periodic timer initialization
-  timer100msec = 0;
-  previous_timer = millis();
+  // timers initialization - registration is checked at once
+  notify_enabled = 0;
+  reg_timer = millis() - REG_PERIOD;
+  poll_timer = millis();
+  led_timer = millis();
+  stats_start = millis();
 }
 
-void loop()
+// -----------------------------------------
+// processing of one received SMS
+// -----------------------------------------
+void ProcessSMS(byte position)
 {
-  // -------------------
-  // timing of main loop
-  // -------------------
-  if ((unsigned long)(millis() - previous_timer) >= 100) { 
-    previous_timer = millis();  
+  unsigned long latency;
 
-  }
-    
-    
-    //*******************************
-    //****** EVERY 3 sec. ***********
-    // %30 means every 3000 msec. = 3sec.
-    //*******************************
-    if ((timer100msec+4) % 30 == 0) {
-
-      // is there a new UNREAD SMS ?
-      // if YES - SIM position > 0 is returned
-      // -------------------------------------
-      if (gsm.IsRegistered()) {  
-        // GSM module is registered
-
-        // Note: if there is new SMS before IsSMSPresent() is executed
-        // this SMS has a status UNREAD
-        // after calling IsSMSPresent() method status of SMS
-        // is automatically changed to READ
-   
-        //Just to signal we are working
-		digitalWrite(ledPin, HIGH);   // sets the LED on
-        delay(200);                  
-        digitalWrite(ledPin, LOW);    // sets the LED off
-        delay(200);    
-
-   
-        position = gsm.IsSMSPresent(SMS_ALL);
-        if (position > 0) {
-
-          // we have new SMS 
-          // now we will make authorization with SIM phonebook pos. 1,2,3
-          // ------------------------------------------------------------
-          gsm.GetSMS(position, phone_num, sms_text, 100);
-          
-            // so lets check SMS text
-            // --------------------------------------
-            if (strstr(subStr(sms_text," ",1), SMS_PASSWORD) != NULL)
-            {
-               //password is correct, so check the command type
-                  
-              if (strstr(subStr(sms_text," ",2), "ANALOG") != NULL) 
-              {  
-                sprintf(string, "A0:%i A1:%i A2:%i A3:%i A4:%i A5:%i",analogRead(0),analogRead(1),analogRead(2),analogRead(3),analogRead(4),analogRead(5));
-                gsm.SendSMS(phone_num, string ); 
-              }
-              else if( strstr(subStr(sms_text," ",2), "INPUTS")!=NULL)
-              {
-                  sprintf(string, "IN1:%i IN2:%i IN3:%i IN4:%i", digitalRead(IN1),digitalRead(IN2),digitalRead(IN3),digitalRead(IN4));
-                  gsm.SendSMS(phone_num, string );  
-              }
-              else if( strstr(subStr(sms_text," ",2), "OUTPUTS")!=NULL)
-              {
-                  sprintf(string, "OUT1:%i OUT2:%i", digitalRead(OUT1),digitalRead(OUT2));
-                  gsm.SendSMS(phone_num, string ); 
-              }
-              else if( strstr(subStr(sms_text," ",2), "OUT1")!=NULL)
-              {
-                if ( strstr(subStr(sms_text," ",3), "ON")!=NULL)
-                {
-                   digitalWrite(OUT1,HIGH); 
-                   gsm.SendSMS(phone_num, "OUT1 IS ON" ); 
-                }
-                else if  ( strstr(subStr(sms_text," ",3), "OFF")!=NULL)
-                {
-                   digitalWrite(OUT1,LOW); 
-                   gsm.SendSMS(phone_num, "OUT1 IS OFF" );
-                } 
-              }
-              else if( strstr(subStr(sms_text," ",2), "OUT2")!=NULL)
-              {
-                if ( strstr(subStr(sms_text," ",3), "ON")!=NULL)
-                {
-                   digitalWrite(OUT2,HIGH); 
-                   gsm.SendSMS(phone_num, "OUT2 IS ON" ); 
-                }
-                else if  ( strstr(subStr(sms_text," ",3), "OFF")!=NULL)
-                {
-                   digitalWrite(OUT2,LOW); 
-                   gsm.SendSMS(phone_num, "OUT2 IS OFF" );
-                } 
-              }
-            }
-
-            // and delete received SMS 
-            // to leave place for next new SMS's
-            // ---------------------------------
-            while(gsm.DeleteSMS(position)!=1)
-            {
-               delay(500); 
-            }
-        }
-      }
+  gsm.GetSMS(position, phone_num, sms_text, SMS_MAX_LEN);
+
+  // so lets check SMS text
+  // the first token is the password, next ones are commands
+  // e.g. "ADMIN ANALOG INPUTS OUT1 ON"
+  // --------------------------------------------------------
+  num_of_tokens = gsm.ParseCmd(sms_text, tokens, CMD_MAX_TOKENS);
+  if (num_of_tokens > 1 && gsm.CmdTokenIs(&tokens[0], SMS_PASSWORD))
+  {
+    //password is correct, so run all commands
+    if (gsm.DispatchCmdList(commands, NUM_OF_COMMANDS, &tokens[1], num_of_tokens - 1) < 0)
+    {
+      gsm.CmdReply("ERROR");
     }
-    
-    
-    
-    //********************************************
-    //********WRAP AROUND COUNTER 10 sec. ********
-    //********************************************
-    timer100msec = (timer100msec + 1) % 100;
-  }	  
+    // and send one reply for all of them
+    gsm.SendCmdReply(phone_num);
 
+    // SMS-in to SMS-out latency
+    latency = millis() - sms_in_time;
+    latency_sum += latency;
+    if (latency > latency_max) latency_max = latency;
+    replies++;
+  }
 
+  // and delete received SMS 
+  // to leave place for next new SMS's
+  // ---------------------------------
+  while(gsm.DeleteSMS(position)!=1)
+  {
+     delay(500); 
+  }
+}
 
-// Function to return a substring defined by a delimiter at an index
-char* subStr (char* str, char *delim, int index) {
-   char *act, *sub, *ptr;
-   static char copy[SMS_MAX_LEN];
-   int i;
+void loop()
+{
+  unsigned long pass_start = micros();
+  byte busy = 0;
+  char position;
 
-   // Since strtok consumes the first arg, make a copy
-   strcpy(copy, str);
+  // -------------------------------------------------
+  // registration is checked every REG_PERIOD msec.
+  // new SMS notifications are enabled after the first
+  // registration(InitParam(PARAM_SET_1) disables them)
+  // -------------------------------------------------
+  if ((unsigned long)(millis() - reg_timer) >= REG_PERIOD) {
+    reg_timer = millis();
+    gsm.CheckRegistration();
+    if (gsm.IsRegistered() && !notify_enabled) {
+      notify_enabled = (gsm.InitNewSMSNotification() == 1);
+    }
+    busy = 1;
+  }
 
-   for (i = 1, act = copy; i <= index; i++, act = NULL) {
-	//Serial.print(".");
-	sub = strtok_r(act, delim, &ptr);
-	if (sub == NULL) break;
-   }
-   return sub;
+  if (gsm.IsRegistered()) {
+    // -------------------------------------------------
+    // new SMS - the module sends +CMTI so the serial
+    // line is read only if something was received
+    // -------------------------------------------------
+    if (gsm.CheckNewSMS() > 0) {
+      sms_in_time = millis();
+      busy = 1;
+    }
+    position = gsm.NextNewSMS();
+    if (position > 0) {
+      ProcessSMS(position);
+      busy = 1;
+    }
+
+    // -------------------------------------------------
+    // notification can be lost during another AT command
+    // so the SIM card is checked also but only rarely
+    // -------------------------------------------------
+    if ((unsigned long)(millis() - poll_timer) >= POLL_PERIOD || gsm.smsNewLost) {
+      poll_timer = millis();
+      gsm.smsNewLost = 0;
+      position = gsm.IsSMSPresent(SMS_ALL);
+      if (position > 0) {
+        sms_in_time = millis();
+        ProcessSMS(position);
+      }
+      busy = 1;
+    }
+  }
 
+  // -------------------------------------------------
+  // just to signal we are working - LED is on for
+  // LED_ON_TIME every LED_PERIOD without delay()
+  // -------------------------------------------------
+  if ((unsigned long)(millis() - led_timer) >= LED_PERIOD) {
+    led_timer = millis();
+    digitalWrite(ledPin, HIGH);   // sets the LED on
+  }
+  else if ((unsigned long)(millis() - led_timer) >= LED_ON_TIME) {
+    digitalWrite(ledPin, LOW);    // sets the LED off
+  }
+
+  // -------------------------------------------------
+  // time of passes without any work is idle time
+  // -------------------------------------------------
+  if (!busy) {
+    idle_usec += micros() - pass_start;
+    if (idle_usec >= 1000) {
+      idle_msec += idle_usec / 1000;
+      idle_usec %= 1000;
+    }
+  }
 }